@@ -83,11 +83,17 @@ def gflags_library(hdrs = [], srcs = [], threads = 1):
         ],
         "//conditions:default": [
             "-DHAVE_UNISTD_H",
+            "-DHAVE_SYS_MMAN_H",
+            "-DHAVE_DIRENT_H",
             "-DHAVE_FNMATCH_H",
             "-DHAVE_PTHREAD",
+            "-DHAVE_DLADDR",
         ],
     })
-    linkopts = []
+    linkopts = select({
+        "//:x64_windows": [],
+        "//conditions:default": ["-ldl"],
+    })
     if threads:
         linkopts += select({
             "//:android": [],
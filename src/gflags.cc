@@ -93,6 +93,10 @@
 #include <cassert>
 #include <cctype>
 #include <cerrno>
+#if defined(HAVE_DIRENT_H)
+#  include <dirent.h>    // for --flagdir
+#  include <sys/stat.h>
+#endif
 #if defined(HAVE_FNMATCH_H)
 #  include <fnmatch.h>
 #elif defined(HAVE_SHLWAPI_H)
@@ -102,9 +106,20 @@
 #include <cstdarg> // For va_list and related operations
 #include <cstdio>
 #include <cstring>
+#include <ctime>
+#if defined(HAVE_DLADDR)
+#  include <dlfcn.h>   // for dladdr()
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_UNISTD_H)
+#  include <fcntl.h>
+#  include <sys/mman.h>  // for mmap() of response files
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
 
 #include <algorithm>
 #include <map>
+#include <set>
 #include <string>
 #include <utility>     // for pair<>
 #include <vector>
@@ -118,6 +133,8 @@ using namespace MUTEX_NAMESPACE;
 // Special flags, type 1: the 'recursive' flags.  They set another flag's val.
 // gflags会自动创建一个名为FLAGS_name的全局变量，用于存储命令行标志的值，如"FALGS_flagfile"
 DEFINE_string(flagfile,   "", "load flags from file");
+DEFINE_string(flagdir,    "", "load flags from a directory holding one file"
+                              " per flag, named after the flag");
 DEFINE_string(fromenv,    "", "set flags from the environment"
                               " [use 'export FLAGS_flag1=value']");
 DEFINE_string(tryfromenv, "", "set flags from the environment if present");
@@ -130,8 +147,11 @@ DEFINE_string(undefok, "", "comma-separated list of flag names that it is okay t
 
 namespace GFLAGS_NAMESPACE {
 
+using std::make_pair;
 using std::map;
+using std::multimap;
 using std::pair;
+using std::set;
 using std::sort;
 using std::string;
 using std::vector;
@@ -139,6 +159,10 @@ using std::vector;
 // This is used by the unittest to test error-exit code
 void GFLAGS_DLL_DECL (*gflags_exitfunc)(int) = &exit;  // from stdlib.h
 
+// The number of batches of flags merged into the registry one by one
+// rather than built into it from sorted ranges, for the unittest.
+GFLAGS_DLL_DECL int gflags_merged_flag_batches = 0;
+
 
 // The help message indicating that the commandline flag has been
 // 'stripped'. It will not show up when doing "-help" and its
@@ -160,6 +184,12 @@ static const char kError[] = "ERROR: ";
 // Enables deferred processing of flags in dynamically loaded libraries.
 static bool allow_command_line_reparsing = false;
 
+// Indicates that @file arguments are to be replaced by the file's words.
+static bool allow_response_files = false;
+
+// How deeply response files may name other response files.
+static const int kMaxResponseFileDepth = 16;
+
 static bool logging_is_probably_set_up = false;
 
 // This is a 'prototype' validate-function.  'Real' validate
@@ -212,6 +242,9 @@ class FlagValue {
 
   template <typename FlagType>
   FlagValue(FlagType* valbuf, bool transfer_ownership_of_value);
+  // A view of the current or the default value of a lazy string flag.
+  // It allocates the string the first time that value is set.
+  FlagValue(fLS::LazyString* lazy, bool is_default);
   ~FlagValue();
 
   bool ParseFrom(const char* spec);
@@ -223,10 +256,12 @@ class FlagValue {
   friend class CommandLineFlag;  // for many things, including Validate()
   // 注意：匿名命名空间创建了一个独立的作用域，它与外层的 GFLAGS_NAMESPACE 命名空间是隔离的，所以这里的FlagSaverImpl前仍需声明GFLAGS_NAMESPACE
   friend class GFLAGS_NAMESPACE::FlagSaverImpl;  // calls New()
+  friend class GFLAGS_NAMESPACE::FlagSandboxImpl;  // New(), value_buffer_
   friend class FlagRegistry;     // checks value_buffer_ for flags_by_ptr_ map
   template <typename T> friend T GetFromEnv(const char*, T);
   friend bool TryParseLocked(const CommandLineFlag*, FlagValue*,
-                             const char*, string*);  // for New(), CopyFrom()
+                             const char*, string*,
+                             bool*);  // for New(), CopyFrom()
 
   template <typename FlagType>
   struct FlagValueTraits;
@@ -243,9 +278,19 @@ class FlagValue {
   // (*validate_fn)(bool) for a bool flag).
   bool Validate(const char* flagname, ValidateFnProto validate_fn_proto) const;
 
+  // For FV_STRING: the value, which may be copied into *scratch if it
+  // is still the literal default of a lazy string flag, and the value
+  // for writing.
+  const string& StringValue(string* scratch) const;
+  string* MutableStringValue();
+
+  enum Laziness { NOT_LAZY, LAZY_CURRENT, LAZY_DEFAULT };
+
   void* const value_buffer_;          // points to the buffer holding our data
   const int8 type_;                   // how to interpret value_
   const bool owns_value_;             // whether to free value on destruct
+  const int8 lazy_;                   // if a Laziness other than NOT_LAZY,
+                                      // value_buffer_ is a fLS::LazyString
 
   // 通过将拷贝构造函数和拷贝赋值运算符声明为私有的，可以防止FlagValue对象的拷贝和赋值
   FlagValue(const FlagValue&);   // no copying!
@@ -286,11 +331,22 @@ FlagValue::FlagValue(FlagType* valbuf,
                      bool transfer_ownership_of_value)
     : value_buffer_(valbuf),
       type_(FlagValueTraits<FlagType>::kValueType),
-      owns_value_(transfer_ownership_of_value) {
+      owns_value_(transfer_ownership_of_value),
+      lazy_(NOT_LAZY) {
+}
+
+FlagValue::FlagValue(fLS::LazyString* lazy, bool is_default)
+    : value_buffer_(lazy),
+      type_(FV_STRING),
+      owns_value_(false),
+      lazy_(is_default ? LAZY_DEFAULT : LAZY_CURRENT) {
 }
 
 FlagValue::~FlagValue() {
-  if (!owns_value_) {
+  // The strings of a lazy string flag belong to its FLAGS_ variable,
+  // which may still be read after the flag left the registry (from a
+  // static destructor, say), so they stay for the life of the program.
+  if (lazy_ != NOT_LAZY || !owns_value_) {
     return;
   }
   switch (type_) {
@@ -323,7 +379,7 @@ bool FlagValue::ParseFrom(const char* value) {
     return false;   // didn't match a legal input
 
   } else if (type_ == FV_STRING) {
-    SET_VALUE_AS(string, value);
+    *MutableStringValue() = value;
     return true;
   }
 
@@ -411,8 +467,10 @@ string FlagValue::ToString() const {
     case FV_DOUBLE:
       snprintf(intbuf, sizeof(intbuf), "%.17g", VALUE_AS(double));
       return intbuf;
-    case FV_STRING:
-      return VALUE_AS(string);
+    case FV_STRING: {
+      string scratch;
+      return StringValue(&scratch);
+    }
     default:
       assert(false);
       return "";  // unknown type
@@ -441,9 +499,11 @@ bool FlagValue::Validate(const char* flagname,
     case FV_DOUBLE:
       return reinterpret_cast<bool (*)(const char*, double)>(
           validate_fn_proto)(flagname, VALUE_AS(double));
-    case FV_STRING:
+    case FV_STRING: {
+      string scratch;
       return reinterpret_cast<bool (*)(const char*, const string&)>(
-          validate_fn_proto)(flagname, VALUE_AS(string));
+          validate_fn_proto)(flagname, StringValue(&scratch));
+    }
     default:
       assert(false);  // unknown type
       return false;
@@ -479,7 +539,10 @@ bool FlagValue::Equal(const FlagValue& x) const {
     case FV_INT64:  return VALUE_AS(int64) == OTHER_VALUE_AS(x, int64);
     case FV_UINT64: return VALUE_AS(uint64) == OTHER_VALUE_AS(x, uint64);
     case FV_DOUBLE: return VALUE_AS(double) == OTHER_VALUE_AS(x, double);
-    case FV_STRING: return VALUE_AS(string) == OTHER_VALUE_AS(x, string);
+    case FV_STRING: {
+      string scratch, x_scratch;
+      return StringValue(&scratch) == x.StringValue(&x_scratch);
+    }
     default: assert(false); return false;  // unknown type
   }
 }
@@ -506,11 +569,72 @@ void FlagValue::CopyFrom(const FlagValue& x) {
     case FV_INT64:  SET_VALUE_AS(int64, OTHER_VALUE_AS(x, int64));    break;
     case FV_UINT64: SET_VALUE_AS(uint64, OTHER_VALUE_AS(x, uint64));  break;
     case FV_DOUBLE: SET_VALUE_AS(double, OTHER_VALUE_AS(x, double));  break;
-    case FV_STRING: SET_VALUE_AS(string, OTHER_VALUE_AS(x, string));  break;
+    case FV_STRING: {
+      string scratch;
+      *MutableStringValue() = x.StringValue(&scratch);
+      break;
+    }
     default: assert(false);  // unknown type
   }
 }
 
+const string& FlagValue::StringValue(string* scratch) const {
+  if (lazy_ == NOT_LAZY)
+    return VALUE_AS(string);
+  const fLS::LazyString* const lazy =
+      reinterpret_cast<const fLS::LazyString*>(value_buffer_);
+  const string* const materialized =
+      lazy_ == LAZY_CURRENT ? lazy->value : lazy->default_copy;
+  if (materialized != NULL)
+    return *materialized;
+  scratch->assign(lazy->default_value);
+  return *scratch;
+}
+
+string* FlagValue::MutableStringValue() {
+  if (lazy_ == NOT_LAZY)
+    return &VALUE_AS(string);
+  fLS::LazyString* const lazy =
+      reinterpret_cast<fLS::LazyString*>(value_buffer_);
+  string** const materialized =
+      lazy_ == LAZY_CURRENT ? &lazy->value : &lazy->default_copy;
+  if (*materialized == NULL)
+    *materialized = new string(lazy->default_value);
+  return *materialized;
+}
+
+// The number of string flags unregistered, counting all of them when
+// the registry is deleted, so a CachedStringFlag can tell without
+// taking the registry lock that the flag whose generation it watches
+// still exists.  Only incremented with the registry lock held.
+static volatile long string_flags_removed = 0;
+
+static long AtomicLoad(const volatile long* counter) {
+#if defined(__GNUC__)
+  return __atomic_load_n(counter, __ATOMIC_ACQUIRE);
+#else
+  return *counter;   // volatile reads acquire on MSVC
+#endif
+}
+
+static void AtomicIncrement(volatile long* counter) {
+#if defined(__GNUC__)
+  __atomic_add_fetch(counter, 1, __ATOMIC_RELEASE);
+#elif defined(OS_WINDOWS)
+  InterlockedIncrement(counter);
+#else
+  ++*counter;
+#endif
+}
+
+static long LoadStringFlagsRemoved() {
+  return AtomicLoad(&string_flags_removed);
+}
+
+static void BumpStringFlagsRemoved() {
+  AtomicIncrement(&string_flags_removed);
+}
+
 // --------------------------------------------------------------------
 // CommandLineFlag
 //    This represents a single flag, including its name, description,
@@ -522,12 +646,61 @@ void FlagValue::CopyFrom(const FlagValue& x) {
 //    this flag.
 // --------------------------------------------------------------------
 
+// How a flag defined with DEFINE_derived gets its value.
+struct Derivation {
+  // dependencies is the stringized list of DEFINE_derived, like
+  // "(total_budget, worker_threads)".
+  Derivation(const char* dependencies, void (*compute_fn)(),
+             void (*compute_into_fn)(void*, void (*)()),
+             void (*assign_fn)(void*, const void*))
+      : compute(compute_fn), compute_into(compute_into_fn),
+        assign(assign_fn), computed(false), refreshing(false),
+        registry_generation(0), flags_generation(0) {
+    string name;
+    for (const char* c = dependencies; ; ++c) {
+      if (*c == ',' || *c == '\0') {
+        if (!name.empty()) {
+          names.push_back(name);
+          if (!list.empty())
+            list += ", ";
+          list += name;
+          name.clear();
+        }
+        if (*c == '\0')
+          break;
+      } else if (*c != '(' && *c != ')' &&
+                 !isspace(static_cast<unsigned char>(*c))) {
+        name += *c;
+      }
+    }
+  }
+
+  vector<string> names;   // of the flags the value is derived from
+  string list;            // the same, for CommandLineFlagInfo
+  void (*const compute)();   // the user's function, type-erased
+  // Store compute() at the first argument, and copy the value from
+  // the second to the first argument, as the type of the flag.
+  void (*const compute_into)(void* value, void (*compute)());
+  void (*const assign)(void* to, const void* from);
+  bool computed;                  // false until the first computation
+  bool refreshing;                // true while it is being refreshed
+  uint64 registry_generation;     // FlagRegistry::generation_ when checked
+  // The flags named by names, or NULL for names no flag has (yet),
+  // looked up again only when FlagRegistry::flags_generation_ changes.
+  vector<const CommandLineFlag*> dependencies;
+  uint64 flags_generation;        // FlagRegistry::flags_generation_ then
+  vector<uint64> dependency_generations;   // theirs when computed
+};
+
 // 每个flag都是一个CommandLineFlag对象，包括flag的名字、描述、默认值和当前值
 class CommandLineFlag {
  public:
   // Note: we take over memory-ownership of current_val and default_val.
+  // We also take ownership of derivation, which is NULL unless the
+  // flag was defined with DEFINE_derived.
   CommandLineFlag(const char* name, const char* help, const char* filename,
-                  FlagValue* current_val, FlagValue* default_val);
+                  FlagValue* current_val, FlagValue* default_val,
+                  Derivation* derivation = NULL);
   ~CommandLineFlag();
 
   const char* name() const { return name_; }
@@ -550,12 +723,26 @@ class CommandLineFlag {
   bool ValidateCurrent() const { return Validate(*current_); }
   bool Modified() const { return modified_; }
 
+  // Returns true if value parses as a value of this flag's type.
+  bool CanParse(const char* value) const;
+  // Returns true if value parses as the current value of this flag.
+  bool HasValue(const char* value) const;
+
+  uint64 generation() const { return generation_; }
+
  private:
   // for SetFlagLocked() and setting flags_by_ptr_
   friend class FlagRegistry;
   friend class GFLAGS_NAMESPACE::FlagSaverImpl;  // for cloning the values
+  friend class GFLAGS_NAMESPACE::FlagSandboxImpl;  // likewise
   // set validate_fn
   friend bool AddFlagValidator(const void*, ValidateFnProto);
+  // set group_
+  friend bool GFLAGS_NAMESPACE::AddFlagToGroup(const void*, const char*);
+  // read derivation_
+  friend bool GFLAGS_NAMESPACE::ReadDerivedFlag(const void*, void*);
+  // read string_generation_
+  friend class GFLAGS_NAMESPACE::CachedStringFlag;
 
   // This copies all the non-const members: modified, processed, defvalue, etc.
   void CopyFrom(const CommandLineFlag& src);
@@ -564,7 +751,8 @@ class CommandLineFlag {
 
   const char* const name_;     // Flag name
   const char* const help_;     // Help message
-  const char* const file_;     // Which file did this come from?
+  const char* file_;           // Which file did this come from?  Interned
+                               // by FlagRegistry once registered.
   bool modified_;              // Set after default assignment?
   FlagValue* defvalue_;        // Default value for flag
   FlagValue* current_;         // Current value for flag
@@ -573,6 +761,17 @@ class CommandLineFlag {
   // When we pass this to current_->Validate(), it will cast it back to
   // the proper type.  This may be NULL to mean we have no validate_fn.
   ValidateFnProto validate_fn_proto_;
+  // The executable or shared library holding our storage, as returned by
+  // ModuleOf().  Only filled in once FlagRegistry indexes flags by module.
+  const void* module_;
+  // The flag group we belong to, interned by FlagRegistry, or NULL.
+  const char* group_;
+  // Incremented whenever the value changes through gflags.
+  uint64 generation_;
+  // Incremented along with generation_ for string flags, atomically,
+  // so a CachedStringFlag can check it without the registry lock.
+  volatile long string_generation_;
+  Derivation* const derivation_;   // owned, NULL for most flags
 
   CommandLineFlag(const CommandLineFlag&);   // no copying!
   void operator=(const CommandLineFlag&);
@@ -580,14 +779,18 @@ class CommandLineFlag {
 
 CommandLineFlag::CommandLineFlag(const char* name, const char* help,
                                  const char* filename,
-                                 FlagValue* current_val, FlagValue* default_val)
+                                 FlagValue* current_val, FlagValue* default_val,
+                                 Derivation* derivation)
     : name_(name), help_(help), file_(filename), modified_(false),
-      defvalue_(default_val), current_(current_val), validate_fn_proto_(NULL) {
+      defvalue_(default_val), current_(current_val), validate_fn_proto_(NULL),
+      module_(NULL), group_(NULL), generation_(0), string_generation_(0),
+      derivation_(derivation) {
 }
 
 CommandLineFlag::~CommandLineFlag() {
   delete current_;
   delete defvalue_;
+  delete derivation_;
 }
 
 const char* CommandLineFlag::CleanFileName() const {
@@ -613,6 +816,12 @@ void CommandLineFlag::FillCommandLineFlagInfo(
   result->is_default = !modified_;
   result->has_validator_fn = validate_function() != NULL;
   result->flag_ptr = flag_ptr();
+  if (derivation_ != NULL) {
+    result->is_default = true;   // nobody sets it
+    result->derived_from = derivation_->list;
+  } else {
+    result->derived_from.clear();
+  }
 }
 
 // 避免因为直接修改FLAGS_name变量而导致modified_标志位没有被更新
@@ -627,12 +836,34 @@ void CommandLineFlag::UpdateModifiedBit() {
 void CommandLineFlag::CopyFrom(const CommandLineFlag& src) {
   // Note we only copy the non-const members; others are fixed at construct time
   if (modified_ != src.modified_) modified_ = src.modified_;
-  if (!current_->Equal(*src.current_)) current_->CopyFrom(*src.current_);
+  if (derivation_ != NULL)
+    return;   // the value follows the flags it is derived from
+  if (!current_->Equal(*src.current_)) {
+    current_->CopyFrom(*src.current_);
+    ++generation_;
+    if (Type() == FlagValue::FV_STRING)
+      AtomicIncrement(&string_generation_);
+  }
   if (!defvalue_->Equal(*src.defvalue_)) defvalue_->CopyFrom(*src.defvalue_);
   if (validate_fn_proto_ != src.validate_fn_proto_)
     validate_fn_proto_ = src.validate_fn_proto_;
 }
 
+bool CommandLineFlag::CanParse(const char* value) const {
+  FlagValue* tentative_value = current_->New();
+  const bool ok = tentative_value->ParseFrom(value);
+  delete tentative_value;
+  return ok;
+}
+
+bool CommandLineFlag::HasValue(const char* value) const {
+  FlagValue* tentative_value = current_->New();
+  const bool ok = (tentative_value->ParseFrom(value) &&
+                   current_->Equal(*tentative_value));
+  delete tentative_value;
+  return ok;
+}
+
 bool CommandLineFlag::Validate(const FlagValue& value) const {
 
   if (validate_function() == NULL)
@@ -652,6 +883,23 @@ bool CommandLineFlag::Validate(const FlagValue& value) const {
 //    the function will acquire it itself if needed.
 // --------------------------------------------------------------------
 
+// Returns an identifier of the executable or shared library that contains
+// the given address (its load address), or NULL if it can't be told.
+static const void* ModuleOf(const void* address) {
+#if defined(HAVE_DLADDR)
+  Dl_info info;
+  if (dladdr(const_cast<void*>(address), &info) != 0)
+    return info.dli_fbase;
+#elif defined(OS_WINDOWS)
+  HMODULE module = NULL;
+  if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+                         GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                         static_cast<LPCSTR>(address), &module))
+    return module;
+#endif
+  return NULL;
+}
+
 struct StringCmp {  // Used by the FlagRegistry map class to compare char*'s
   bool operator() (const char* s1, const char* s2) const {
     return (strcmp(s1, s2) < 0);
@@ -661,44 +909,131 @@ struct StringCmp {  // Used by the FlagRegistry map class to compare char*'s
 
 class FlagRegistry {
  public:
-  FlagRegistry() {
+  FlagRegistry()
+      : name_index_built_(false), name_hash_built_(false),
+        module_index_built_(false),
+        active_group_(NULL), restrict_to_group_(false), generation_(0),
+        flags_generation_(0) {
   }
   ~FlagRegistry() {
     // Not using STLDeleteElements as that resides in util and this
     // class is base.
     for (FlagMap::iterator p = flags_.begin(), e = flags_.end(); p != e; ++p) {
+      if (IsAlias(p))
+        continue;   // deleted under its own name
       CommandLineFlag* flag = p->second;
       delete flag;
     }
+    for (size_t i = 0; i < pending_.size(); ++i)
+      delete pending_[i];
   }
 
   static void DeleteGlobalRegistry() {
+    BumpStringFlagsRemoved();
     delete global_registry_;
     global_registry_ = NULL;
   }
 
   // Store a flag in this registry.  Takes ownership of the given pointer.
+  // The flag only becomes visible with the next Lock(); see pending_.
   void RegisterFlag(CommandLineFlag* flag);
 
-  void Lock() { lock_.Lock(); }
+  // Removes the flag from this registry and from every FlagSaver taken
+  // of it, then deletes it.  The storage of the flag is left alone.
+  void UnregisterFlagLocked(CommandLineFlag* flag);
+
+  // Makes alias another name of the flag called target, from now on
+  // or from when that flag gets registered.  Both strings must outlive
+  // the alias.  A deprecated alias warns, once, when it is first used.
+  void RegisterAlias(const char* alias, const char* target, bool deprecated);
+  void UnregisterAliasLocked(const char* alias);
+
+  // Exchanges the set of deprecated aliases that have already warned
+  // with *warned, so a warning can be printed again and later be
+  // forgotten.
+  void SwapAliasWarningsLocked(set<string>* warned);
+
+  // Unregisters all flags whose storage lives in the given module (as
+  // returned by ModuleOf()), and the aliases named there, and forgets
+  // its file name pointers.  Returns the number of flags removed.
+  int UnregisterModuleLocked(const void* module);
+
+  // FlagSavers register themselves so they can forget unregistered flags.
+  void AddSaverLocked(FlagSaverImpl* saver) { savers_.insert(saver); }
+  void RemoveSaverLocked(FlagSaverImpl* saver) { savers_.erase(saver); }
+
+  void Lock() {
+    lock_.Lock();
+    if (!pending_.empty())
+      AddPendingFlagsLocked();
+  }
   void Unlock() { lock_.Unlock(); }
 
   // Returns the flag object for the specified name, or NULL if not found.
   CommandLineFlag* FindFlagLocked(const char* name);
 
+  // Like FindFlagLocked, but also returns NULL for the flags of
+  // inactive flag groups.  This is what parsing uses.
+  CommandLineFlag* FindActiveFlagLocked(const char* name) {
+    CommandLineFlag* flag = FindFlagLocked(name);
+    return (flag != NULL && IsActiveLocked(flag)) ? flag : NULL;
+  }
+
+  // Returns the interned copy of the given source file name, shared
+  // by all flags of the file.  Interned names compare equal iff they
+  // are the same pointer, and stay valid when the module that defined
+  // the flags is unloaded.
+  const char* InternFileLocked(const char* filename);
+
+  // Returns the interned copy of the given flag group name.
+  const char* InternGroupLocked(const char* group) {
+    return group_names_.insert(group).first->c_str();
+  }
+
+  // Restricts parsing, validation and GetAllFlags() to the flags
+  // outside of any group plus those in the given one.  NULL lifts
+  // the restriction.  Returns false if no flag is in the group.
+  bool SetActiveGroupLocked(const char* group);
+
+  // Whether flag takes part in parsing, validation and help.
+  bool IsActiveLocked(const CommandLineFlag* flag) const {
+    return (!restrict_to_group_ || flag->group_ == NULL ||
+            flag->group_ == active_group_);
+  }
+
   // Returns the flag object whose current-value is stored at flag_ptr.
   // That is, for whom current_->value_buffer_ == flag_ptr
   CommandLineFlag* FindFlagViaPtrLocked(const void* flag_ptr);
 
+  // Appends the flags in the subtree named by prefix, as documented
+  // for ForEachFlagWithPrefix(), in name order.  flags_ is sorted by
+  // name, so the subtree is one contiguous range of it.
+  void FindFlagsWithPrefixLocked(const char* prefix,
+                                 vector<CommandLineFlag*>* flags);
+
+  // Appends the active flags whose names are closest to name by edit
+  // distance, if any are close enough to be what was meant, in order
+  // of distance and then name.  At most max_flags are appended.
+  void SuggestFlagsLocked(const char* name, size_t max_flags,
+                          vector<const CommandLineFlag*>* flags);
+
   // A fancier form of FindFlag that works correctly if name is of the
   // form flag=value.  In that case, we set key to point to flag, and
   // modify v to point to the value (if present), and return the flag
   // with the given name.  If the flag does not exist, returns NULL
-  // and sets error_message.
+  // and sets error_message, unless error_message is NULL.
   CommandLineFlag* SplitArgumentLocked(const char* argument,
                                        string* key, const char** v,
                                        string* error_message);
 
+  // The error message for an unknown flag, with suggestions.
+  string UnknownFlagMessageLocked(const char* name);
+
+  // Computes the value of a DEFINE_derived flag again if one of the
+  // flags it derives from changed since the last time.  Does nothing
+  // for other flags.
+  void RefreshDerivedLocked(CommandLineFlag* flag);
+
   // Set the value of a flag.  If the flag was successfully set to
   // value, set msg to indicate the new flag-value, and return true.
   // Otherwise, set msg to indicate the error, leave flag unchanged,
@@ -708,6 +1043,11 @@ class FlagRegistry {
 
   static FlagRegistry* GlobalRegistry();   // returns a singleton registry
 
+  // Returns the singleton registry if it exists, without creating it.
+  // This is NULL before the first flag is registered and after
+  // ShutDownCommandLineFlags().
+  static FlagRegistry* GlobalRegistryIfExists() { return global_registry_; }
+
  private:
   friend class GFLAGS_NAMESPACE::FlagSaverImpl;  // reads all the flags in order to copy them
   friend class CommandLineFlagParser;    // for ValidateUnmodifiedFlags
@@ -715,15 +1055,116 @@ class FlagRegistry {
 
   // The map from name to flag, for FindFlagLocked().
   // key是char*类型，value是CommandLineFlag*类型，StringCmp是比较函数，用于确保key可以按照字典序排序
+  // Aliases are entries of their own, so a lookup resolves them in
+  // the same probe; code walking all flags must skip them.
   typedef map<const char*, CommandLineFlag*, StringCmp> FlagMap;
   typedef FlagMap::iterator FlagIterator;
   typedef FlagMap::const_iterator FlagConstIterator;
   FlagMap flags_;
 
+  // The flags registered since the last Lock().  Static initialization
+  // registers hundreds of flags in a row, and inserting each into
+  // flags_ and flags_by_ptr_ on its own costs O(n log n) comparisons
+  // and rebalancing under the lock.  Instead RegisterFlag() only
+  // appends here, and AddPendingFlagsLocked() sorts the batch, checks
+  // it for duplicate names in one pass and builds both maps from the
+  // sorted ranges in linear time.  A later batch, left by a validator,
+  // flag group or alias that used the registry during static
+  // initialization or by a module loaded later, is merged into the maps
+  // in order.  Duplicates are thus reported the first time the registry
+  // is used rather than while registering.
+  vector<CommandLineFlag*> pending_;
+  void AddPendingFlagsLocked();
+  // Adds a batch to maps that already hold flags.  Sorts *flags.
+  void MergeFlagsLocked(vector<CommandLineFlag*>* flags);
+  // Dies since flag has the name of the existing entry of flags_.
+  static void ReportDuplicateFlag(FlagConstIterator existing,
+                                  const CommandLineFlag* flag);
+  // Dies since flag has the name of an alias of the flag named target.
+  static void ReportAliasConflict(const CommandLineFlag* flag,
+                                  const char* target);
+
+  // Whether the entry of flags_ is an alias rather than the flag's
+  // own name.  Keys are the very name pointers of the flags.
+  static bool IsAlias(FlagConstIterator i) {
+    return i->first != i->second->name();
+  }
+
+  // All aliases, including those whose flag is not registered (yet),
+  // and from the name of each flag to its aliases.
+  struct FlagAlias {
+    const char* target;
+    bool deprecated;
+    bool warned;   // whether the deprecation warning has been printed
+  };
+  typedef map<const char*, FlagAlias, StringCmp> AliasMap;
+  AliasMap aliases_;
+  typedef multimap<const char*, const char*, StringCmp> AliasTargetMap;
+  AliasTargetMap aliases_by_target_;
+
+  // A BK-tree of the flag names for SuggestFlagsLocked(): the children
+  // of a node are keyed by their edit distance to it, so a query only
+  // descends into the children whose distance can be within bounds.
+  // Suggestions are only made for errors, so the tree is built the
+  // first time one is asked for, and again after flags were added or
+  // removed.
+  struct NameIndexNode {
+    explicit NameIndexNode(const CommandLineFlag* f) : flag(f) { }
+    const CommandLineFlag* flag;
+    vector<pair<size_t, size_t> > children;   // distance, node index
+  };
+  vector<NameIndexNode> name_index_;
+  bool name_index_built_;
+  void BuildNameIndexLocked();
+
+  // A perfect hash of the names in flags_ for FindFlagLocked(), which
+  // then resolves a name with one hash and one compare instead of a
+  // string comparison per level of the map.  Names are first hashed
+  // into buckets of a few; each bucket gets the smallest seed that
+  // moves all of its names into free slots, larger buckets first
+  // (hash and displace).  The set of flags is fixed in most binaries
+  // once static initialization is done, so the table is built the
+  // first time a flag is looked up, and again after flags or aliases
+  // were added or removed.  Empty slots hold flags_.end(); if no seeds
+  // are found, the table stays empty and lookups use the map.
+  vector<uint32> name_hash_seeds_;          // per bucket
+  vector<FlagConstIterator> name_hash_slots_;
+  bool name_hash_built_;
+  void BuildNameHashLocked();
+
   // The map from current-value pointer to flag, fo FindFlagViaPtrLocked().
   typedef map<const void*, CommandLineFlag*> FlagPtrMap;
   FlagPtrMap flags_by_ptr_;
 
+  // The map from module to the flags it defines, for
+  // UnregisterModuleLocked().  Resolving the module of a flag is not
+  // free, so this is only built the first time it is needed.
+  typedef multimap<const void*, CommandLineFlag*> FlagModuleMap;
+  FlagModuleMap flags_by_module_;
+  bool module_index_built_;
+
+  // The FlagSavers that currently hold a backup of this registry.
+  set<FlagSaverImpl*> savers_;
+
+  // The names of all flag groups.  Flags point at these strings, so
+  // group membership and activity are checked by pointer comparison.
+  set<string> group_names_;
+
+  // The names of all source files defining flags, for InternFileLocked().
+  // Flags of one file normally share the __FILE__ pointer, so that is
+  // looked up first.
+  set<string> file_names_;
+  map<const char*, const char*> interned_files_;
+  const char* active_group_;   // interned, or NULL if it has no flags
+  bool restrict_to_group_;     // false until a group was activated
+
+  // Incremented along with the generation of any flag, so derived
+  // flags can tell cheaply that nothing changed at all.
+  uint64 generation_;
+  // Incremented whenever flags_ changes, so derived flags know to look
+  // up the flags they depend on again.
+  uint64 flags_generation_;
+
   static FlagRegistry* global_registry_;   // a singleton registry
 
   Mutex lock_;
@@ -748,34 +1189,352 @@ class FlagRegistryLock {
 // 在flags_注册表中插入一个pair对象，key是flag的name，value是CommandLineFlag*对象
 // 并在flags_by_ptr_注册表中插入一个pair对象，key是flag的current_->value_buffer_，value是CommandLineFlag*对象
 void FlagRegistry::RegisterFlag(CommandLineFlag* flag) {
-  Lock();
-  // insert方法返回一个pair对象，first是一个迭代器，指向插入或是已存在的元素，second是一个bool值，表示是否插入成功
-  pair<FlagIterator, bool> ins =
-    flags_.insert(pair<const char*, CommandLineFlag*>(flag->name(), flag));
-  if (ins.second == false) {   // means the name was already in the map
-  // ins.first是一个map迭代器，ins.first->second指向的是一个map键值对中的value对象，即CommandLineFlag*对象
-    if (strcmp(ins.first->second->filename(), flag->filename()) != 0) {
-      ReportError(DIE, "ERROR: flag '%s' was defined more than once "
-                  "(in files '%s' and '%s').\n",
-                  flag->name(),
-                  ins.first->second->filename(),
-                  flag->filename());
-    } else {
-      ReportError(DIE, "ERROR: something wrong with flag '%s' in file '%s'.  "
-                  "One possibility: file '%s' is being linked both statically "
-                  "and dynamically into this executable.\n",
-                  flag->name(),
-                  flag->filename(), flag->filename());
+  lock_.Lock();   // not Lock(): that would add the pending flags each time
+  flag->file_ = InternFileLocked(flag->file_);
+  pending_.push_back(flag);
+  lock_.Unlock();
+}
+
+static bool FlagNameLess(const CommandLineFlag* a, const CommandLineFlag* b) {
+  return strcmp(a->name(), b->name()) < 0;
+}
+
+static bool FlagPtrLess(const CommandLineFlag* a, const CommandLineFlag* b) {
+  return a->flag_ptr() < b->flag_ptr();
+}
+
+void FlagRegistry::AddPendingFlagsLocked() {
+  name_index_built_ = false;
+  name_hash_built_ = false;
+  ++flags_generation_;
+  vector<CommandLineFlag*> flags;
+  flags.swap(pending_);
+  // stable, so that of two flags of the same name the one registered
+  // first is the one kept in the registry, as when adding one by one.
+  std::stable_sort(flags.begin(), flags.end(), FlagNameLess);
+  bool unique = true;
+  for (size_t i = 1; i < flags.size() && unique; ++i)
+    unique = (strcmp(flags[i - 1]->name(), flags[i]->name()) != 0);
+  if (!unique || !flags_.empty() || !flags_by_ptr_.empty() ||
+      module_index_built_) {
+    // A module loaded later, flags registered after a validator, flag
+    // group or alias flushed the first batch, or a duplicate that needs
+    // its diagnostic.
+    MergeFlagsLocked(&flags);
+    return;
+  }
+  // The map constructors take linear time for sorted ranges.
+  vector<pair<const char*, CommandLineFlag*> > by_name;
+  by_name.reserve(flags.size());
+  for (size_t i = 0; i < flags.size(); ++i)
+    by_name.push_back(pair<const char*, CommandLineFlag*>(flags[i]->name(),
+                                                          flags[i]));
+  FlagMap(by_name.begin(), by_name.end()).swap(flags_);
+  std::sort(flags.begin(), flags.end(), FlagPtrLess);
+  vector<pair<const void*, CommandLineFlag*> > by_ptr;
+  by_ptr.reserve(flags.size());
+  for (size_t i = 0; i < flags.size(); ++i)
+    by_ptr.push_back(pair<const void*, CommandLineFlag*>(flags[i]->flag_ptr(),
+                                                         flags[i]));
+  FlagPtrMap(by_ptr.begin(), by_ptr.end()).swap(flags_by_ptr_);
+  // Hook up the aliases that were registered before the flags.  An
+  // alias named like a flag of the batch is an error, as it is when
+  // flags are added one by one.
+  for (AliasTargetMap::const_iterator i = aliases_by_target_.begin();
+       i != aliases_by_target_.end(); ++i) {
+    FlagConstIterator flag = flags_.find(i->first);
+    if (flag == flags_.end())
+      continue;
+    pair<FlagIterator, bool> alias =
+        flags_.insert(pair<const char*, CommandLineFlag*>(i->second,
+                                                          flag->second));
+    if (!alias.second)
+      ReportAliasConflict(alias.first->second, flag->second->name());
+  }
+}
+
+void FlagRegistry::ReportAliasConflict(const CommandLineFlag* flag,
+                                       const char* target) {
+  ReportError(DIE, "ERROR: flag '%s' in file '%s' is also defined as "
+              "an alias of flag '%s'.\n",
+              flag->name(), flag->filename(), target);
+}
+
+void FlagRegistry::ReportDuplicateFlag(FlagConstIterator existing,
+                                       const CommandLineFlag* flag) {
+  // existing->second指向的是已经注册的同名CommandLineFlag*对象
+  if (IsAlias(existing)) {
+    ReportAliasConflict(flag, existing->second->name());
+  } else if (strcmp(existing->second->filename(), flag->filename()) != 0) {
+    ReportError(DIE, "ERROR: flag '%s' was defined more than once "
+                "(in files '%s' and '%s').\n",
+                flag->name(),
+                existing->second->filename(),
+                flag->filename());
+  } else {
+    ReportError(DIE, "ERROR: something wrong with flag '%s' in file '%s'.  "
+                "One possibility: file '%s' is being linked both statically "
+                "and dynamically into this executable.\n",
+                flag->name(),
+                flag->filename(), flag->filename());
+  }
+}
+
+void FlagRegistry::MergeFlagsLocked(vector<CommandLineFlag*>* flags) {
+  ++gflags_merged_flag_batches;
+  // Each flag is inserted with the position after the flag inserted
+  // before it as the hint, which takes amortized constant time while
+  // the batch fills the gap between two names already in the map, as
+  // the flags of one file mostly do.  insert() with a hint does not
+  // tell whether the name was already there, the size does.
+  FlagIterator name_hint = flags_.begin();
+  for (size_t i = 0; i < flags->size(); ++i) {
+    CommandLineFlag* const flag = (*flags)[i];
+    const size_t size = flags_.size();
+    FlagIterator ins = flags_.insert(
+        name_hint, pair<const char*, CommandLineFlag*>(flag->name(), flag));
+    if (flags_.size() == size)   // means the name was already in the map
+      ReportDuplicateFlag(ins, flag);
+    name_hint = ++ins;
+  }
+  std::sort(flags->begin(), flags->end(), FlagPtrLess);
+  FlagPtrMap::iterator ptr_hint = flags_by_ptr_.begin();
+  for (size_t i = 0; i < flags->size(); ++i) {
+    CommandLineFlag* const flag = (*flags)[i];
+    FlagPtrMap::iterator ins = flags_by_ptr_.insert(
+        ptr_hint, pair<const void*, CommandLineFlag*>(flag->flag_ptr(), flag));
+    ins->second = flag;
+    ptr_hint = ++ins;
+  }
+  if (module_index_built_) {
+    for (size_t i = 0; i < flags->size(); ++i) {
+      CommandLineFlag* const flag = (*flags)[i];
+      flag->module_ = ModuleOf(flag->flag_ptr());
+      flags_by_module_.insert(pair<const void*, CommandLineFlag*>(flag->module_,
+                                                                  flag));
+    }
+  }
+  // Hook up the aliases that were registered before the flags.
+  for (size_t i = 0; i < flags->size() && !aliases_by_target_.empty(); ++i) {
+    CommandLineFlag* const flag = (*flags)[i];
+    pair<AliasTargetMap::iterator, AliasTargetMap::iterator> range =
+        aliases_by_target_.equal_range(flag->name());
+    for (AliasTargetMap::iterator j = range.first; j != range.second; ++j) {
+      pair<FlagIterator, bool> alias =
+          flags_.insert(pair<const char*, CommandLineFlag*>(j->second, flag));
+      if (!alias.second)   // a flag of that name was registered first
+        ReportAliasConflict(alias.first->second, flag->name());
     }
   }
-  // Also add to the flags_by_ptr_ map.
-  flags_by_ptr_[flag->current_->value_buffer_] = flag;
+}
+
+const char* FlagRegistry::InternFileLocked(const char* filename) {
+  map<const char*, const char*>::const_iterator i =
+      interned_files_.find(filename);
+  if (i != interned_files_.end())
+    return i->second;
+  const char* const interned = file_names_.insert(filename).first->c_str();
+  interned_files_[filename] = interned;
+  interned_files_[interned] = interned;
+  return interned;
+}
+
+void FlagRegistry::RegisterAlias(const char* alias, const char* target,
+                                 bool deprecated) {
+  Lock();
+  FlagConstIterator existing = flags_.find(alias);
+  if (existing != flags_.end() && !IsAlias(existing)) {
+    ReportError(DIE, "ERROR: alias '%s' of flag '%s' is also the name of "
+                "a flag defined in file '%s'.\n",
+                alias, target, existing->second->filename());
+  }
+  FlagAlias info = { target, deprecated, false };
+  if (!aliases_.insert(pair<const char*, FlagAlias>(alias, info)).second) {
+    ReportError(DIE, "ERROR: alias '%s' was defined more than once.\n",
+                alias);
+  }
+  aliases_by_target_.insert(pair<const char*, const char*>(target, alias));
+  FlagConstIterator flag = flags_.find(target);
+  if (flag != flags_.end() && !IsAlias(flag)) {
+    flags_.insert(pair<const char*, CommandLineFlag*>(alias, flag->second));
+    name_hash_built_ = false;
+    ++flags_generation_;
+  }
   Unlock();
 }
 
+void FlagRegistry::UnregisterAliasLocked(const char* alias) {
+  AliasMap::iterator info = aliases_.find(alias);
+  if (info == aliases_.end())
+    return;
+  FlagIterator entry = flags_.find(alias);
+  if (entry != flags_.end() && IsAlias(entry)) {
+    flags_.erase(entry);
+    name_hash_built_ = false;
+    ++flags_generation_;
+  }
+  pair<AliasTargetMap::iterator, AliasTargetMap::iterator> range =
+      aliases_by_target_.equal_range(info->second.target);
+  for (AliasTargetMap::iterator i = range.first; i != range.second; ++i) {
+    if (strcmp(i->second, alias) == 0) {
+      aliases_by_target_.erase(i);
+      break;
+    }
+  }
+  aliases_.erase(info);
+}
+
+void FlagRegistry::SwapAliasWarningsLocked(set<string>* warned) {
+  set<string> previous;
+  for (AliasMap::iterator i = aliases_.begin(); i != aliases_.end(); ++i) {
+    if (i->second.warned)
+      previous.insert(i->first);
+    i->second.warned = (warned->count(i->first) != 0);
+  }
+  warned->swap(previous);
+}
+
+int FlagRegistry::UnregisterModuleLocked(const void* module) {
+  if (!module_index_built_) {
+    for (FlagPtrMap::const_iterator i = flags_by_ptr_.begin();
+         i != flags_by_ptr_.end(); ++i) {
+      CommandLineFlag* flag = i->second;
+      flag->module_ = ModuleOf(flag->flag_ptr());
+      flags_by_module_.insert(pair<const void*, CommandLineFlag*>(flag->module_,
+                                                                  flag));
+    }
+    module_index_built_ = true;
+  }
+  pair<FlagModuleMap::iterator, FlagModuleMap::iterator> range =
+      flags_by_module_.equal_range(module);
+  vector<CommandLineFlag*> doomed;
+  for (FlagModuleMap::iterator i = range.first; i != range.second; ++i)
+    doomed.push_back(i->second);
+  for (size_t i = 0; i < doomed.size(); ++i)
+    UnregisterFlagLocked(doomed[i]);
+  // Aliases are few, and their names are literals of the module.
+  vector<const char*> doomed_aliases;
+  for (AliasMap::const_iterator i = aliases_.begin(); i != aliases_.end();
+       ++i) {
+    if (ModuleOf(i->first) == module)
+      doomed_aliases.push_back(i->first);
+  }
+  for (size_t i = 0; i < doomed_aliases.size(); ++i)
+    UnregisterAliasLocked(doomed_aliases[i]);
+  // The module's __FILE__ literals go with it, and a module loaded
+  // later may have a different one at the same address.
+  for (map<const char*, const char*>::iterator i = interned_files_.begin();
+       i != interned_files_.end(); ) {
+    if (i->first != i->second && ModuleOf(i->first) == module)
+      interned_files_.erase(i++);
+    else
+      ++i;
+  }
+  return static_cast<int>(doomed.size());
+}
+
 // 通过name找到对应的CommandLineFlag对象
+// FNV-1a, computed once per lookup; the bucket and the slot are both
+// derived from it.
+static uint64 NameHash(const char* name) {
+  uint64 hash = 14695981039346656037ULL;
+  for (const unsigned char* p = reinterpret_cast<const unsigned char*>(name);
+       *p != '\0'; ++p) {
+    hash ^= *p;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static inline size_t NameHashBucket(uint64 hash, size_t num_buckets) {
+  return static_cast<size_t>((hash >> 32) % num_buckets);
+}
+
+static inline size_t NameHashSlot(uint64 hash, uint32 seed, size_t num_slots) {
+  // The finalizer of MurmurHash3, so that seeds give unrelated slots.
+  hash ^= seed * 0x9E3779B97F4A7C15ULL;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ULL;
+  hash ^= hash >> 33;
+  return static_cast<size_t>(hash % num_slots);
+}
+
+static bool BucketSizeGreater(const pair<size_t, size_t>& a,
+                              const pair<size_t, size_t>& b) {
+  return a.first > b.first;
+}
+
+void FlagRegistry::BuildNameHashLocked() {
+  name_hash_built_ = true;
+  name_hash_seeds_.clear();
+  name_hash_slots_.clear();
+  const size_t num_names = flags_.size();
+  if (num_names == 0)
+    return;
+  // Buckets of about four names; one spare slot in eight keeps the
+  // search for the last seeds short.
+  const size_t num_buckets = num_names / 4 + 1;
+  const size_t num_slots = num_names + num_names / 8 + 1;
+  vector<vector<pair<uint64, FlagConstIterator> > > buckets(num_buckets);
+  for (FlagConstIterator i = flags_.begin(); i != flags_.end(); ++i) {
+    const uint64 hash = NameHash(i->first);
+    buckets[NameHashBucket(hash, num_buckets)].push_back(make_pair(hash, i));
+  }
+  vector<pair<size_t, size_t> > order;   // size, bucket
+  order.reserve(num_buckets);
+  for (size_t b = 0; b < num_buckets; ++b)
+    order.push_back(make_pair(buckets[b].size(), b));
+  std::stable_sort(order.begin(), order.end(), BucketSizeGreater);
+
+  vector<uint32> seeds(num_buckets, 0);
+  vector<FlagConstIterator> slots(num_slots, flags_.end());
+  vector<size_t> taken;
+  for (size_t o = 0; o < order.size() && order[o].first > 0; ++o) {
+    const vector<pair<uint64, FlagConstIterator> >& bucket =
+        buckets[order[o].second];
+    uint32 seed = 0;
+    for (;;) {
+      if (++seed > (1U << 20))
+        return;   // practically never; FindFlagLocked() uses the map
+      taken.clear();
+      size_t n = 0;
+      for (; n < bucket.size(); ++n) {
+        const size_t slot = NameHashSlot(bucket[n].first, seed, num_slots);
+        if (slots[slot] != flags_.end() ||
+            std::find(taken.begin(), taken.end(), slot) != taken.end())
+          break;
+        taken.push_back(slot);
+      }
+      if (n == bucket.size())
+        break;
+    }
+    seeds[order[o].second] = seed;
+    for (size_t n = 0; n < bucket.size(); ++n)
+      slots[taken[n]] = bucket[n].second;
+  }
+  name_hash_seeds_.swap(seeds);
+  name_hash_slots_.swap(slots);
+}
+
 CommandLineFlag* FlagRegistry::FindFlagLocked(const char* name) {
-  FlagConstIterator i = flags_.find(name);
+  if (!name_hash_built_)
+    BuildNameHashLocked();
+  FlagConstIterator i = flags_.end();
+  if (!name_hash_slots_.empty()) {
+    const uint64 hash = NameHash(name);
+    const uint32 seed =
+        name_hash_seeds_[NameHashBucket(hash, name_hash_seeds_.size())];
+    if (seed != 0) {   // else no name hashes to the bucket
+      FlagConstIterator slot =
+          name_hash_slots_[NameHashSlot(hash, seed, name_hash_slots_.size())];
+      if (slot != flags_.end() && strcmp(slot->first, name) == 0)
+        i = slot;
+    }
+  } else {
+    i = flags_.find(name);
+  }
   if (i == flags_.end()) {
     // If the name has dashes in it, try again after replacing with
     // underscores.
@@ -785,10 +1544,35 @@ CommandLineFlag* FlagRegistry::FindFlagLocked(const char* name) {
     // c_str()返回一个指向正规C字符串的指针常量，内容与string相同
     return FindFlagLocked(name_rep.c_str());
   } else {
+    if (IsAlias(i)) {
+      FlagAlias& alias = aliases_[i->first];
+      if (alias.deprecated && !alias.warned) {
+        alias.warned = true;
+        ReportError(DO_NOT_DIE, "WARNING: flag name '%s' is deprecated, "
+                    "use '%s' instead\n", i->first, alias.target);
+      }
+    }
     return i->second;
   }
 }
 
+void FlagRegistry::FindFlagsWithPrefixLocked(const char* prefix,
+                                             vector<CommandLineFlag*>* flags) {
+  string key = prefix;
+  std::replace(key.begin(), key.end(), '.', '_');
+  std::replace(key.begin(), key.end(), '-', '_');
+  const bool whole_names = !key.empty() && key[key.size() - 1] != '_';
+  for (FlagConstIterator i = flags_.lower_bound(key.c_str());
+       i != flags_.end() && strncmp(i->first, key.c_str(), key.size()) == 0;
+       ++i) {
+    const char next = i->first[key.size()];
+    if (whole_names && next != '\0' && next != '_')
+      continue;   // a sibling such as storage_caches of storage_cache
+    if (!IsAlias(i))
+      flags->push_back(i->second);
+  }
+}
+
 // 通过flag_ptr找到对应的CommandLineFlag对象
 CommandLineFlag* FlagRegistry::FindFlagViaPtrLocked(const void* flag_ptr) {
   FlagPtrMap::const_iterator i = flags_by_ptr_.find(flag_ptr);
@@ -799,7 +1583,135 @@ CommandLineFlag* FlagRegistry::FindFlagViaPtrLocked(const void* flag_ptr) {
   }
 }
 
+bool FlagRegistry::SetActiveGroupLocked(const char* group) {
+  if (group == NULL) {
+    restrict_to_group_ = false;
+    active_group_ = NULL;
+    return true;
+  }
+  restrict_to_group_ = true;
+  set<string>::const_iterator i = group_names_.find(group);
+  active_group_ = (i == group_names_.end()) ? NULL : i->c_str();
+  return active_group_ != NULL;
+}
+
 // 在arg中分离出key与v(value)，根据key找到对应的CommandLineFlag对象
+// Returns the Levenshtein distance of a and b, or some value above
+// limit once it is known to be above limit.
+static size_t EditDistance(const char* a, size_t a_len,
+                           const char* b, size_t b_len, size_t limit) {
+  if (a_len > b_len + limit || b_len > a_len + limit)
+    return limit + 1;
+  vector<size_t> row(b_len + 1), next(b_len + 1);
+  for (size_t j = 0; j <= b_len; ++j)
+    row[j] = j;
+  for (size_t i = 1; i <= a_len; ++i) {
+    next[0] = i;
+    size_t row_min = next[0];
+    for (size_t j = 1; j <= b_len; ++j) {
+      const size_t substitution = row[j - 1] + (a[i - 1] != b[j - 1]);
+      next[j] = std::min(substitution, std::min(row[j], next[j - 1]) + 1);
+      row_min = std::min(row_min, next[j]);
+    }
+    if (row_min > limit)
+      return limit + 1;
+    row.swap(next);
+  }
+  return row[b_len];
+}
+
+static bool SuggestionLess(const pair<size_t, const CommandLineFlag*>& a,
+                           const pair<size_t, const CommandLineFlag*>& b) {
+  if (a.first != b.first)
+    return a.first < b.first;
+  return strcmp(a.second->name(), b.second->name()) < 0;
+}
+
+void FlagRegistry::BuildNameIndexLocked() {
+  name_index_.clear();
+  for (FlagConstIterator i = flags_.begin(); i != flags_.end(); ++i) {
+    if (IsAlias(i))
+      continue;   // suggest the names flags are listed under
+    const char* const name = i->second->name();
+    const size_t name_len = strlen(name);
+    const size_t index = name_index_.size();
+    name_index_.push_back(NameIndexNode(i->second));
+    size_t node = 0;
+    while (index > 0) {
+      const char* const node_name = name_index_[node].flag->name();
+      const size_t distance =
+          EditDistance(name, name_len, node_name, strlen(node_name),
+                       std::max(name_len, strlen(node_name)));
+      vector<pair<size_t, size_t> >& children = name_index_[node].children;
+      size_t c = 0;
+      while (c < children.size() && children[c].first != distance)
+        ++c;
+      if (c == children.size()) {
+        children.push_back(make_pair(distance, index));
+        break;
+      }
+      node = children[c].second;
+    }
+  }
+  name_index_built_ = true;
+}
+
+void FlagRegistry::SuggestFlagsLocked(const char* name, size_t max_flags,
+                                      vector<const CommandLineFlag*>* flags) {
+  if (!name_index_built_)
+    BuildNameIndexLocked();
+  if (name_index_.empty())
+    return;
+  // Beyond a third of the name, a flag is more likely something else.
+  const size_t name_len = strlen(name);
+  const size_t tolerance =
+      std::max<size_t>(1, std::min<size_t>(3, name_len / 3));
+  vector<pair<size_t, const CommandLineFlag*> > found;   // by distance
+  vector<size_t> pending(1, 0);
+  while (!pending.empty()) {
+    const NameIndexNode& node = name_index_[pending.back()];
+    pending.pop_back();
+    const char* const node_name = node.flag->name();
+    const size_t node_name_len = strlen(node_name);
+    const size_t distance =
+        EditDistance(name, name_len, node_name, node_name_len,
+                     std::max(name_len, node_name_len));   // exact
+    if (distance <= tolerance && IsActiveLocked(node.flag))
+      found.push_back(make_pair(distance, node.flag));
+    // By the triangle inequality, only the children at distance -
+    // tolerance .. distance + tolerance from this node can be close
+    // enough to name.
+    for (size_t c = 0; c < node.children.size(); ++c) {
+      const size_t child_distance = node.children[c].first;
+      if (child_distance + tolerance >= distance &&
+          child_distance <= distance + tolerance)
+        pending.push_back(node.children[c].second);
+    }
+  }
+  sort(found.begin(), found.end(), SuggestionLess);
+  for (size_t i = 0; i < found.size() && i < max_flags; ++i) {
+    if (found[i].first > found[0].first)
+      break;   // only the closest are suggested
+    flags->push_back(found[i].second);
+  }
+}
+
+string FlagRegistry::UnknownFlagMessageLocked(const char* name) {
+  string message = StringPrintf("%sunknown command line flag '%s'",
+                                kError, name);
+  vector<const CommandLineFlag*> suggestions;
+  SuggestFlagsLocked(name, 3, &suggestions);
+  for (size_t i = 0; i < suggestions.size(); ++i) {
+    message += (i == 0 ? " (did you mean '" :
+                i + 1 < suggestions.size() ? "', '" : "' or '");
+    message += suggestions[i]->name();
+  }
+  if (!suggestions.empty())
+    message += "'?)";
+  message += "\n";
+  return message;
+}
+
 CommandLineFlag* FlagRegistry::SplitArgumentLocked(const char* arg,
                                                    string* key,
                                                    const char** v,
@@ -819,7 +1731,7 @@ CommandLineFlag* FlagRegistry::SplitArgumentLocked(const char* arg,
   }
   flag_name = key->c_str();
 
-  CommandLineFlag* flag = FindFlagLocked(flag_name);
+  CommandLineFlag* flag = FindActiveFlagLocked(flag_name);
 
   if (flag == NULL) {
     // If we can't find the flag-name, then we should return an error.
@@ -828,22 +1740,23 @@ CommandLineFlag* FlagRegistry::SplitArgumentLocked(const char* arg,
     // In that case, we want to return flag 'x'.
     if (!(flag_name[0] == 'n' && flag_name[1] == 'o')) {
       // flag-name is not 'nox', so we're not in the exception case.
-      *error_message = StringPrintf("%sunknown command line flag '%s'\n",
-                                    kError, key->c_str());
+      if (error_message)
+        *error_message = UnknownFlagMessageLocked(key->c_str());
       return NULL;
     }
-    flag = FindFlagLocked(flag_name+2);
+    flag = FindActiveFlagLocked(flag_name+2);
     if (flag == NULL) {
       // No flag named 'x' exists, so we're not in the exception case.
-      *error_message = StringPrintf("%sunknown command line flag '%s'\n",
-                                    kError, key->c_str());
+      if (error_message)
+        *error_message = UnknownFlagMessageLocked(key->c_str());
       return NULL;
     }
     if (flag->Type() != FlagValue::FV_BOOL) {
       // 'x' exists but is not boolean, so we're not in the exception case.
-      *error_message = StringPrintf(
-          "%sboolean value (%s) specified for %s command line flag\n",
-          kError, key->c_str(), flag->type_name());
+      if (error_message)
+        *error_message = StringPrintf(
+            "%sboolean value (%s) specified for %s command line flag\n",
+            kError, key->c_str(), flag->type_name());
       return NULL;
     }
     // We're in the exception case!
@@ -862,8 +1775,9 @@ CommandLineFlag* FlagRegistry::SplitArgumentLocked(const char* arg,
 
 // 将value的值设置到flag_value中
 // 先解析，再验证，最后赋值
+// changed, if not NULL, tells whether flag_value is now different.
 bool TryParseLocked(const CommandLineFlag* flag, FlagValue* flag_value,
-                    const char* value, string* msg) {
+                    const char* value, string* msg, bool* changed) {
   // Use tenative_value, not flag_value, until we know value is valid.
   FlagValue* tentative_value = flag_value->New();
   if (!tentative_value->ParseFrom(value)) {
@@ -887,6 +1801,8 @@ bool TryParseLocked(const CommandLineFlag* flag, FlagValue* flag_value,
     delete tentative_value;
     return false;
   } else {
+    if (changed)
+      *changed = !flag_value->Equal(*tentative_value);
     flag_value->CopyFrom(*tentative_value);
     if (msg) {
       StringAppendF(msg, "%s set to %s\n",
@@ -902,11 +1818,19 @@ bool FlagRegistry::SetFlagLocked(CommandLineFlag* flag,
                                  const char* value,
                                  FlagSettingMode set_mode,
                                  string* msg) {
+  if (flag->derivation_ != NULL) {
+    if (msg) {
+      *msg = StringPrintf("%sflag '%s' is derived from other flags and "
+                          "cannot be set\n", kError, flag->name());
+    }
+    return false;
+  }
   flag->UpdateModifiedBit();
+  bool changed = false;   // whether the current value changed
   switch (set_mode) {
     case SET_FLAGS_VALUE: {
       // set or modify the flag's value
-      if (!TryParseLocked(flag, flag->current_, value, msg))
+      if (!TryParseLocked(flag, flag->current_, value, msg, &changed))
         return false;
       flag->modified_ = true;
       break;
@@ -914,7 +1838,7 @@ bool FlagRegistry::SetFlagLocked(CommandLineFlag* flag,
     case SET_FLAG_IF_DEFAULT: {
       // set the flag's value, but only if it hasn't been set by someone else
       if (!flag->modified_) {
-        if (!TryParseLocked(flag, flag->current_, value, msg))
+        if (!TryParseLocked(flag, flag->current_, value, msg, &changed))
           return false;
         flag->modified_ = true;
       } else {
@@ -925,11 +1849,11 @@ bool FlagRegistry::SetFlagLocked(CommandLineFlag* flag,
     }
     case SET_FLAGS_DEFAULT: {
       // modify the flag's default-value
-      if (!TryParseLocked(flag, flag->defvalue_, value, msg))
+      if (!TryParseLocked(flag, flag->defvalue_, value, msg, NULL))
         return false;
       if (!flag->modified_) {
         // Need to set both defvalue *and* current, in this case
-        TryParseLocked(flag, flag->current_, value, NULL);
+        TryParseLocked(flag, flag->current_, value, NULL, &changed);
       }
       break;
     }
@@ -940,9 +1864,61 @@ bool FlagRegistry::SetFlagLocked(CommandLineFlag* flag,
     }
   }
 
+  if (changed) {
+    ++flag->generation_;
+    ++generation_;
+    if (flag->Type() == FlagValue::FV_STRING)
+      AtomicIncrement(&flag->string_generation_);
+  }
   return true;
 }
 
+void FlagRegistry::RefreshDerivedLocked(CommandLineFlag* flag) {
+  Derivation* const derivation = flag->derivation_;
+  // A flag that is being refreshed already derives from itself; it
+  // keeps its value rather than recursing forever.
+  if (derivation == NULL || derivation->refreshing ||
+      (derivation->computed && derivation->registry_generation == generation_ &&
+       derivation->flags_generation == flags_generation_))
+    return;
+  derivation->registry_generation = generation_;
+  // Flags were added or removed since the names were looked up, so
+  // the old pointers may dangle: look them up again and recompute.
+  bool changed = !derivation->computed;
+  if (derivation->flags_generation != flags_generation_ ||
+      derivation->dependencies.size() != derivation->names.size()) {
+    derivation->dependencies.clear();
+    for (size_t i = 0; i < derivation->names.size(); ++i) {
+      derivation->dependencies.push_back(
+          FindFlagLocked(derivation->names[i].c_str()));
+    }
+    derivation->flags_generation = flags_generation_;
+    derivation->dependency_generations.assign(
+        derivation->dependencies.size(), 0);
+    changed = true;
+  }
+  // Derived dependencies are brought up to date first, so that their
+  // generation tells whether their value changed.
+  derivation->refreshing = true;
+  for (size_t i = 0; i < derivation->dependencies.size(); ++i) {
+    const CommandLineFlag* dependency = derivation->dependencies[i];
+    if (dependency == NULL)
+      continue;
+    RefreshDerivedLocked(const_cast<CommandLineFlag*>(dependency));
+    if (dependency->generation_ != derivation->dependency_generations[i]) {
+      derivation->dependency_generations[i] = dependency->generation_;
+      changed = true;
+    }
+  }
+  if (changed) {
+    derivation->compute_into(flag->current_->value_buffer_,
+                             derivation->compute);
+    derivation->computed = true;
+    ++flag->generation_;
+  }
+  derivation->refreshing = false;
+}
+
 // Get the singleton FlagRegistry object
 // 这里使用单例模式，因为整个应用程序应该只有一个这样的注册表
 FlagRegistry* FlagRegistry::global_registry_ = NULL;
@@ -957,6 +1933,181 @@ FlagRegistry* FlagRegistry::GlobalRegistry() {
   return global_registry_;
 }
 
+// --------------------------------------------------------------------
+// FlagChangeScheduler
+//    Holds flag changes that are to happen at a later time, and the
+//    thread that makes them.  Pending changes are kept ordered by
+//    deadline, one queue for the wall clock and one for the monotonic
+//    clock; the thread is started with the first change and sleeps
+//    until the earliest deadline, or until an earlier change comes in.
+//    Changes are made with SetCommandLineOption(), outside our lock,
+//    so they take the registry lock the normal way.  Shutdown() joins
+//    the thread, so no change is in flight when the registry goes away.
+// --------------------------------------------------------------------
+
+#if defined(HAVE_PTHREAD) && !defined(NO_THREADS)
+
+static double WallClockNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double MonotonicNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+class FlagChangeScheduler {
+ public:
+  static FlagChangeScheduler* Instance() {
+    static FlagChangeScheduler* scheduler = new FlagChangeScheduler;
+    return scheduler;    // never deleted: the thread may outlive main()
+  }
+
+  // deadline is in seconds on the wall clock, or on the monotonic
+  // clock if monotonic is true.  Returns false if the thread can't be
+  // started.
+  bool Add(const string& name, const string& value,
+           bool monotonic, double deadline) {
+    pthread_mutex_lock(&mu_);
+    bool ok = started_;
+    if (!ok && !stopping_)
+      ok = started_ = (pthread_create(&thread_, NULL, &ThreadMain, this) == 0);
+    if (ok) {
+      (monotonic ? mono_changes_ : wall_changes_).insert(
+          make_pair(deadline, make_pair(name, value)));
+      pthread_cond_signal(&cv_);   // it may be due before the others
+    }
+    pthread_mutex_unlock(&mu_);
+    return ok;
+  }
+
+  // Drops all pending changes and waits for the thread to finish the
+  // changes it is making, if any.  A later Add() starts a new thread.
+  void Shutdown() {
+    pthread_mutex_lock(&mu_);
+    wall_changes_.clear();
+    mono_changes_.clear();
+    if (!started_) {
+      pthread_mutex_unlock(&mu_);
+      return;
+    }
+    if (pthread_equal(thread_, pthread_self())) {
+      // Called from a scheduled change: the thread stops after it.
+      pthread_detach(thread_);
+      started_ = false;
+      pthread_mutex_unlock(&mu_);
+      return;
+    }
+    stopping_ = true;
+    pthread_cond_signal(&cv_);
+    pthread_mutex_unlock(&mu_);
+    pthread_join(thread_, NULL);
+    pthread_mutex_lock(&mu_);
+    started_ = false;
+    stopping_ = false;
+    pthread_mutex_unlock(&mu_);
+  }
+
+ private:
+  typedef multimap<double, pair<string, string> > ChangeQueue;
+
+  FlagChangeScheduler() : started_(false), stopping_(false) {
+    pthread_mutex_init(&mu_, NULL);
+    pthread_cond_init(&cv_, NULL);
+  }
+
+  static void* ThreadMain(void* scheduler) {
+    static_cast<FlagChangeScheduler*>(scheduler)->Run();
+    return NULL;
+  }
+
+  // Moves the changes in queue that are due at now to due.
+  static void TakeDue(ChangeQueue* queue, double now,
+                      vector<pair<string, string> >* due) {
+    ChangeQueue::iterator end = queue->upper_bound(now);
+    for (ChangeQueue::iterator it = queue->begin(); it != end; ++it)
+      due->push_back(it->second);
+    queue->erase(queue->begin(), end);
+  }
+
+  void Run() {
+    pthread_mutex_lock(&mu_);
+    const pthread_t self = pthread_self();
+    while (started_ && !stopping_ && pthread_equal(thread_, self)) {
+      const double wall_now = WallClockNow();
+      const double mono_now = MonotonicNow();
+      vector<pair<string, string> > due;
+      TakeDue(&wall_changes_, wall_now, &due);
+      TakeDue(&mono_changes_, mono_now, &due);
+      if (!due.empty()) {
+        pthread_mutex_unlock(&mu_);
+        for (size_t i = 0; i < due.size(); ++i) {
+          const char* name = due[i].first.c_str();
+          const char* value = due[i].second.c_str();
+          if (SetCommandLineOption(name, value).empty())
+            ReportError(DO_NOT_DIE, "ERROR: scheduled change of flag '%s'"
+                        " to '%s' failed\n", name, value);
+        }
+        pthread_mutex_lock(&mu_);
+        continue;
+      }
+
+      if (wall_changes_.empty() && mono_changes_.empty()) {
+        pthread_cond_wait(&cv_, &mu_);
+        continue;
+      }
+      // Sleep on the wall clock until the next deadline on either clock.
+      // Waking early is harmless, since we look at both clocks again.
+      double wake = 1e300;
+      if (!wall_changes_.empty())
+        wake = wall_changes_.begin()->first;
+      if (!mono_changes_.empty())
+        wake = std::min(wake,
+                        wall_now + (mono_changes_.begin()->first - mono_now));
+      struct timespec abstime;
+      abstime.tv_sec = static_cast<time_t>(wake);
+      abstime.tv_nsec = static_cast<long>((wake - abstime.tv_sec) * 1e9);
+      pthread_cond_timedwait(&cv_, &mu_, &abstime);
+    }
+    pthread_mutex_unlock(&mu_);
+  }
+
+  pthread_mutex_t mu_;
+  pthread_cond_t cv_;
+  pthread_t thread_;   // if started_
+  bool started_;
+  bool stopping_;      // set by Shutdown() until the thread is joined
+  ChangeQueue wall_changes_;
+  ChangeQueue mono_changes_;
+};
+
+// Schedules name to be set to value at when seconds since the epoch,
+// or, if relative is true, when seconds from now.
+static bool ScheduleChange(const string& name, const string& value,
+                           bool relative, double when) {
+  if (relative)
+    return FlagChangeScheduler::Instance()->Add(name, value, true,
+                                                MonotonicNow() + when);
+  return FlagChangeScheduler::Instance()->Add(name, value, false, when);
+}
+
+static void ShutDownScheduledChanges() {
+  FlagChangeScheduler::Instance()->Shutdown();
+}
+
+#else  // no threads: there is nobody to make the change later
+
+static bool ScheduleChange(const string&, const string&, bool, double) {
+  return false;
+}
+
+static void ShutDownScheduledChanges() { }
+
+#endif
+
 // --------------------------------------------------------------------
 // CommandLineFlagParser
 //    Parsing is done in two stages.  In the first, we go through
@@ -975,9 +2126,31 @@ FlagRegistry* FlagRegistry::GlobalRegistry() {
 class CommandLineFlagParser {
  public:
   // The argument is the flag-registry to register the parsed flags in
-  explicit CommandLineFlagParser(FlagRegistry* reg) : registry_(reg) {}
+  explicit CommandLineFlagParser(FlagRegistry* reg)
+      : registry_(reg), limits_(NULL), undo_(NULL), flags_set_(0),
+        validating_(false), sandbox_(NULL) {}
   ~CommandLineFlagParser() {}
 
+  // Puts the parser in restricted mode: only plain flag assignments
+  // within limits are accepted, and undo gets a backup of every flag
+  // before it is first changed.
+  void Restrict(const FlagUpdateLimits* limits, FlagSaverImpl* undo) {
+    limits_ = limits;
+    undo_ = undo;
+  }
+
+  // Puts the parser in validation mode: undo gets a backup of every
+  // flag before it is first changed, flagfiles that cannot be read are
+  // errors rather than fatal, and scheduled changes are only checked.
+  void Validate(FlagSaverImpl* undo) {
+    undo_ = undo;
+    validating_ = true;
+  }
+
+  // Puts the parser in sandbox mode: flags are set in sandbox rather
+  // than in the registry, and --flagfile and friends are read from it.
+  void Sandbox(FlagSandboxImpl* sandbox) { sandbox_ = sandbox; }
+
   // Stage 1: Every time this is called, it reads all flags in argv.
   // However, it ignores all flags that have been successfully set
   // before.  Typically this is only called once, so this 'reparsing'
@@ -985,6 +2158,20 @@ class CommandLineFlagParser {
   // reparse after loading a dll, though.
   uint32 ParseNewCommandLineFlags(int* argc, char*** argv, bool remove_flags);
 
+  // Replaces every @file argument before a "--" with the words of that
+  // file, if AllowCommandLineResponseFiles() was called.  When anything
+  // is replaced, *argv is pointed to a new array which, like the words
+  // it points to, is owned by gflags and lives until
+  // ShutDownCommandLineFlags().
+  void ExpandResponseFiles(int* argc, char*** argv);
+
+  // Reads the flagfiles named by --flagfile arguments that are not
+  // regular files, like --flagfile=- or a pipe, into memory.  Waiting
+  // for their input may take a while, so ParseNewCommandLineFlags()
+  // calls this before it locks the registry; the contents are applied
+  // later under that one lock.
+  void PrefetchFlagfiles(int argc, char* const* argv);
+
   // Stage 2: print reporting info and exit, if requested.
   // In gflags_reporting.cc:HandleCommandLineHelpFlags().
 
@@ -995,6 +2182,9 @@ class CommandLineFlagParser {
 
   // Stage 4: report any errors and return true if any were found.
   bool ReportErrors();
+  // Like ReportErrors(), but stores the errors in *error_message
+  // rather than printing them.
+  bool CollectErrors(string* error_message);
 
   // Set a particular command line option.  "newval" is a string
   // describing the new value that the option has been set to.  If
@@ -1017,11 +2207,20 @@ class CommandLineFlagParser {
   string ProcessOptionsFromStringLocked(const string& contentdata,
                                         FlagSettingMode set_mode);
 
+  // Like ProcessOptionsFromStringLocked, but reads the flagfile contents
+  // from fp a line at a time, so only the current line is ever held in
+  // memory.  Works for pipes and terminals as well as regular files.
+  // filename is used for error messages.
+  // NB: Must have called registry_->Lock() before calling this function.
+  string ProcessOptionsFromStreamLocked(FILE* fp, const char* filename,
+                                        FlagSettingMode set_mode);
+
   // These are the 'recursive' flags, defined at the top of this file.
   // Whenever we see these flags on the commandline, we must take action.
   // These are called by ProcessSingleOptionLocked and, similarly, return
   // new values if everything went ok, or the empty-string if not.
   string ProcessFlagfileLocked(const string& flagval, FlagSettingMode set_mode);
+  string ProcessFlagdirLocked(const string& flagval, FlagSettingMode set_mode);
   // diff fromenv/tryfromenv
   string ProcessFromenvLocked(const string& flagval, FlagSettingMode set_mode,
                               bool errors_are_fatal);
@@ -1031,6 +2230,66 @@ class CommandLineFlagParser {
   map<string, string> error_flags_;      // map from name to error message
   // This could be a set<string>, but we reuse the map to minimize the .o size
   map<string, string> undefined_names_;  // --[flag] name was not registered
+  // Set by PrefetchFlagfiles(), and used up by ProcessFlagfileLocked().
+  map<string, string> prefetched_flagfiles_;
+
+  // In restricted mode, checks that setting flag to value is allowed,
+  // recording an error if not.
+  bool AllowedInRestrictedModeLocked(CommandLineFlag* flag,
+                                     const char* value);
+
+  // Set by Restrict() and Validate().
+  const FlagUpdateLimits* limits_;
+  FlagSaverImpl* undo_;
+  size_t flags_set_;                     // flag assignments seen so far
+  bool validating_;
+
+  // Set by Sandbox().
+  FlagSandboxImpl* sandbox_;
+
+  // Sets the flag in the sandbox or else in the registry, like
+  // FlagRegistry::SetFlagLocked().
+  bool SetFlagLocked(CommandLineFlag* flag, const char* value,
+                     FlagSettingMode set_mode, string* msg);
+
+  // Returns the value of the given string flag in the sandbox, which
+  // is the flag itself outside of sandbox mode.
+  const string& StringFlagValue(const string& flag) const;
+
+  // Where we are in a flagfile: whether the flags we see apply to this
+  // program, whether we are in the middle of a list of filenames, and
+  // the prefix set by the last [section] line.
+  struct FlagfileState {
+    FlagfileState() : flags_are_relevant(true), in_filename_section(false) {}
+    bool flags_are_relevant;   // set to false when filenames don't match
+    bool in_filename_section;
+    string section_prefix;     // "storage_cache_" after [storage_cache]
+    // The flags named section_prefix + key, looked up when the section
+    // starts.  The registry stays locked for the whole flagfile.
+    map<string, CommandLineFlag*> section_flags;
+  };
+
+  // Fills state->section_flags for state->section_prefix.
+  void FindSectionFlagsLocked(FlagfileState* state);
+
+  // By API, flagfile lines naming no flag, or a flag but no value, are
+  // silently ignored.  When validating, they are recorded as errors.
+  void IgnoreFlagfileLine(const CommandLineFlag* flag, const string& key);
+
+  // Handles the part after the '@' of a flagfile line scheduling a
+  // flag change: a time, either seconds since the epoch or +seconds
+  // from now, then whitespace and a --flag=value.
+  string ScheduleOptionLocked(const char* time_and_flag);
+
+  // Handles one line of a flagfile, which need not be NUL-terminated.
+  string ProcessOptionLineLocked(const char* line, size_t len,
+                                 FlagfileState* state,
+                                 FlagSettingMode set_mode);
+
+  // Appends args to expanded, recursively replacing response files.
+  // Sets *seen_dashdash once a "--" is copied.
+  void AppendExpandedArgs(char* const* args, size_t n, int depth,
+                          bool* seen_dashdash, vector<char*>* expanded);
 };
 
 
@@ -1050,7 +2309,7 @@ static void ParseFlagList(const char* value, vector<string>* flags) {
 
     if (len == 0)
       ReportError(DIE, "ERROR: empty flaglist entry\n");
-    if (value[0] == '-')
+    if (value[0] == '-' && len > 1)   // a lone "-" means stdin
       // %*s用于打印一个字符串，其中*表示字符串的宽度由另一个参数（在这里是len）动态指定，s表示要打印的是一个字符串
       ReportError(DIE, "ERROR: flag \"%*s\" begins with '-'\n", len, value);
 
@@ -1065,31 +2324,303 @@ static void ParseFlagList(const char* value, vector<string>* flags) {
 // perror根据全局变量errno的当前值，打印一个描述性错误消息到标准错误输出(stderr)，s是perror函数的参数，它会被打印在错误消息的前面
 #define PFATAL(s)  do { perror(s); gflags_exitfunc(1); } while (0)
 
-// 读取文件内容到一个string中
-static string ReadFileIntoString(const char* filename) {
+// 读取文件内容到s中。Returns false and sets errno on failure.
+// 读取fp中剩下的内容到s中。Returns false and sets errno on failure.
+static bool ReadStreamIntoString(FILE* fp, string* s) {
   const int kBufSize = 8092;
   char buffer[kBufSize];
-  string s;
-  // FILE是一个定义在<stdio.h>中的结构体，用于文件操作，表示一个文件流
-  FILE* fp;
-  // SafeFOpen函数用于打开一个文件，如果失败则返回错误码，成功返回0
-  if ((errno = SafeFOpen(&fp, filename, "r")) != 0) PFATAL(filename);
   size_t n;
   // fread函数用于从文件流fp中读取数据存入buffer中，返回值是实际读取的元素个数，如果出错或者读到文件末尾则返回0
   while ( (n=fread(buffer, 1, kBufSize, fp)) > 0 ) {
-    // ferror函数用于检查文件流fp是否出错，如果出错则返回非0值
-    if (ferror(fp))  PFATAL(filename);
-    s.append(buffer, n);
+    s->append(buffer, n);
   }
+  // ferror函数用于检查文件流fp是否出错，如果出错则返回非0值
+  return !ferror(fp);
+}
+
+static bool TryReadFileIntoString(const char* filename, string* s) {
+  // FILE是一个定义在<stdio.h>中的结构体，用于文件操作，表示一个文件流
+  FILE* fp;
+  // SafeFOpen函数用于打开一个文件，如果失败则返回错误码，成功返回0
+  if ((errno = SafeFOpen(&fp, filename, "r")) != 0) return false;
+  const bool ok = ReadStreamIntoString(fp, s);
+  const int error = errno;
   fclose(fp);
+  errno = error;
+  return ok;
+}
+
+// 读取文件内容到一个string中
+static string ReadFileIntoString(const char* filename) {
+  string s;
+  if (!TryReadFileIntoString(filename, &s)) PFATAL(filename);
   return s;
 }
 
+// Splits the len bytes at buf into words the way a POSIX shell does,
+// minus expansions: words are separated by whitespace, and quoting
+// with '...', "..." and backslashes works as usual.  The words are
+// unquoted and NUL-terminated in place, which is possible since they
+// never get longer, and appended to words.  Only a last word ending
+// right at buf+len, where there's no room for the NUL, is copied, with
+// new[], and also appended to copies.
+static void SplitWordsInPlace(char* buf, size_t len, vector<char*>* words,
+                              vector<char*>* copies) {
+  char* const end = buf + len;
+  char* r = buf;                   // next byte to read
+  while (true) {
+    while (r < end && isspace(static_cast<unsigned char>(*r)))
+      ++r;
+    if (r == end)
+      break;
+    char* const word = r;
+    char* w = r;                   // next byte of word to write
+    char quote = '\0';
+    for (; r < end; ++r) {
+      const char c = *r;
+      if (quote == '\'') {
+        if (c == '\'') quote = '\0';
+        else *w++ = c;
+      } else if (quote == '"') {
+        if (c == '"') {
+          quote = '\0';
+        } else if (c == '\\' && r + 1 < end && strchr("\"\\$`\n", r[1])) {
+          if (*++r != '\n') *w++ = *r;     // a line continuation is dropped
+        } else {
+          *w++ = c;
+        }
+      } else if (isspace(static_cast<unsigned char>(c))) {
+        break;
+      } else if (c == '\'' || c == '"') {
+        quote = c;
+      } else if (c == '\\' && r + 1 < end) {
+        if (*++r != '\n') *w++ = *r;
+      } else {
+        *w++ = c;
+      }
+    }
+    if (w < end) {
+      *w = '\0';
+      words->push_back(word);
+    } else {
+      char* copy = new char[w - word + 1];
+      memcpy(copy, word, w - word);
+      copy[w - word] = '\0';
+      words->push_back(copy);
+      copies->push_back(copy);
+    }
+    if (r < end)
+      ++r;                         // skip the separator
+  }
+}
+
+// The words of a response file, and what they point into.
+struct ResponseFile {
+  ResponseFile() : map(NULL), map_len(0), buffer(NULL) {}
+  ~ResponseFile();
+
+  vector<char*> words;
+  vector<char*> copies;   // the words that don't point into the file
+  void* map;              // the mapping of a regular file, or NULL
+  size_t map_len;
+  char* buffer;           // malloc()ed contents of other files, or NULL
+};
+
+ResponseFile::~ResponseFile() {
+  for (size_t i = 0; i < copies.size(); ++i)
+    delete[] copies[i];
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_UNISTD_H)
+  if (map != NULL)
+    munmap(map, map_len);
+#endif
+  free(buffer);
+}
+
+// Reads the response file and splits it into words.  Regular files are
+// mapped copy-on-write, so only the pages we unquote words in are ever
+// copied; pipes such as /dev/fd/N are read in chunks into one buffer.
+// Returns false and sets errno if the file can't be read.
+static bool ReadResponseFile(const char* filename, ResponseFile* file) {
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_UNISTD_H)
+  const int fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    const size_t len = static_cast<size_t>(st.st_size);
+    if (len > 0) {
+      void* const map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                             fd, 0);
+      if (map == MAP_FAILED) {
+        const int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return false;
+      }
+      file->map = map;
+      file->map_len = len;
+      SplitWordsInPlace(static_cast<char*>(map), len, &file->words,
+                        &file->copies);
+    }
+    close(fd);
+    return true;
+  }
+  close(fd);
+#endif
+  FILE* fp;
+  if ((errno = SafeFOpen(&fp, filename, "rb")) != 0)
+    return false;
+  size_t size = 0;
+  size_t capacity = 8192;
+  char* buffer = static_cast<char*>(malloc(capacity));
+  size_t n;
+  while (buffer != NULL &&
+         (n = fread(buffer + size, 1, capacity - size, fp)) > 0) {
+    size += n;
+    if (size == capacity) {
+      capacity *= 2;
+      char* const bigger = static_cast<char*>(realloc(buffer, capacity));
+      if (bigger == NULL) free(buffer);
+      buffer = bigger;
+    }
+  }
+  const bool ok = (buffer != NULL && !ferror(fp));
+  const int saved_errno = buffer == NULL ? ENOMEM : errno;
+  fclose(fp);
+  if (!ok) {
+    free(buffer);
+    errno = saved_errno;
+    return false;
+  }
+  file->buffer = buffer;
+  SplitWordsInPlace(buffer, size, &file->words, &file->copies);
+  return true;
+}
+
+// Owns the response files read so far, and the argv arrays they were
+// expanded into, until ShutDownCommandLineFlags().  Each file is read
+// once: parsing the same @file again, as ReparseCommandLineNonHelpFlags()
+// and FlagSandboxes may, reuses its words.
+static Mutex response_files_lock(Mutex::LINKER_INITIALIZED);
+static map<string, ResponseFile*>* response_files = NULL;
+static vector<char**>* response_file_argvs = NULL;
+
+// Returns the words of the response file, reading it the first time.
+// Returns NULL and sets errno if it can't be read.
+static const vector<char*>* ResponseFileWords(const char* filename) {
+  MutexLock l(&response_files_lock);
+  if (response_files == NULL)
+    response_files = new map<string, ResponseFile*>;
+  map<string, ResponseFile*>::const_iterator i =
+      response_files->find(filename);
+  if (i != response_files->end())
+    return &i->second->words;
+  ResponseFile* const file = new ResponseFile;
+  if (!ReadResponseFile(filename, file)) {
+    const int saved_errno = errno;
+    delete file;
+    errno = saved_errno;
+    return NULL;
+  }
+  (*response_files)[filename] = file;
+  return &file->words;
+}
+
+static void AddResponseFileArgv(char** argv) {
+  MutexLock l(&response_files_lock);
+  if (response_file_argvs == NULL)
+    response_file_argvs = new vector<char**>;
+  response_file_argvs->push_back(argv);
+}
+
+// Deletes an argv array from ExpandResponseFiles() early.
+static void DeleteResponseFileArgv(char** argv) {
+  MutexLock l(&response_files_lock);
+  if (response_file_argvs == NULL)
+    return;
+  vector<char**>::iterator i = std::find(response_file_argvs->begin(),
+                                         response_file_argvs->end(), argv);
+  if (i != response_file_argvs->end()) {
+    response_file_argvs->erase(i);
+    delete[] argv;
+  }
+}
+
+static void DeleteResponseFiles() {
+  MutexLock l(&response_files_lock);
+  if (response_files != NULL) {
+    for (map<string, ResponseFile*>::iterator i = response_files->begin();
+         i != response_files->end(); ++i)
+      delete i->second;
+    delete response_files;
+    response_files = NULL;
+  }
+  if (response_file_argvs != NULL) {
+    for (size_t i = 0; i < response_file_argvs->size(); ++i)
+      delete[] (*response_file_argvs)[i];
+    delete response_file_argvs;
+    response_file_argvs = NULL;
+  }
+}
+
+void CommandLineFlagParser::AppendExpandedArgs(char* const* args, size_t n,
+                                               int depth, bool* seen_dashdash,
+                                               vector<char*>* expanded) {
+  for (size_t i = 0; i < n; ++i) {
+    char* const arg = args[i];
+    if (*seen_dashdash || arg[0] != '@' || arg[1] == '\0') {
+      if (strcmp(arg, "--") == 0)
+        *seen_dashdash = true;
+      expanded->push_back(arg);
+      continue;
+    }
+    if (depth >= kMaxResponseFileDepth) {
+      error_flags_[arg] = StringPrintf(
+          "%sresponse files nested too deeply at '%s'\n", kError, arg);
+      continue;
+    }
+    const vector<char*>* const words = ResponseFileWords(arg + 1);
+    if (words == NULL) {
+      error_flags_[arg] = StringPrintf(
+          "%scould not read response file '%s': %s\n",
+          kError, arg + 1, strerror(errno));
+      continue;
+    }
+    AppendExpandedArgs(words->empty() ? NULL : &(*words)[0], words->size(),
+                       depth + 1, seen_dashdash, expanded);
+  }
+}
+
+void CommandLineFlagParser::ExpandResponseFiles(int* argc, char*** argv) {
+  if (!allow_response_files)
+    return;
+  int i = 1;
+  for (; i < *argc; ++i) {
+    const char* arg = (*argv)[i];
+    if (strcmp(arg, "--") == 0) return;
+    if (arg[0] == '@' && arg[1] != '\0') break;
+  }
+  if (i == *argc)
+    return;                        // nothing to expand; keep the argv we got
+
+  vector<char*> expanded(*argv, *argv + i);
+  bool seen_dashdash = false;
+  AppendExpandedArgs(*argv + i, *argc - i, 0, &seen_dashdash, &expanded);
+  char** new_argv = new char*[expanded.size() + 1];
+  std::copy(expanded.begin(), expanded.end(), new_argv);
+  new_argv[expanded.size()] = NULL;
+  AddResponseFileArgv(new_argv);
+  *argc = static_cast<int>(expanded.size());
+  *argv = new_argv;
+}
+
 // argc是命令行参数的个数，argv是命令行参数的数组
 uint32 CommandLineFlagParser::ParseNewCommandLineFlags(int* argc, char*** argv,
                                                        bool remove_flags) {
+  ExpandResponseFiles(argc, argv);
   int first_nonopt = *argc;        // for non-options moved to the end
 
+  PrefetchFlagfiles(*argc, *argv);
   registry_->Lock();
   for (int i = 1; i < first_nonopt; i++) {
     // 我的理解是char*=string，所以这是一个指向char型指针数组的指针，其中的每一个元素都是一个字符串（说白了，就是一个指向二维数组的指针）
@@ -1119,15 +2650,15 @@ uint32 CommandLineFlagParser::ParseNewCommandLineFlags(int* argc, char*** argv,
       break;
     }
 
-    // Find the flag object for this option
+    // Find the flag object for this option.  If there isn't one, the
+    // error message is built by ReportErrors(), and only if --undefok
+    // doesn't cover the name.
     string key;
     const char* value;
-    string error_message;
     CommandLineFlag* flag = registry_->SplitArgumentLocked(arg, &key, &value,
-                                                           &error_message);
+                                                           NULL);
     if (flag == NULL) {
       undefined_names_[key] = "";    // value isn't actually used
-      error_flags_[key] = error_message;
       continue;
     }
 
@@ -1182,11 +2713,68 @@ uint32 CommandLineFlagParser::ParseNewCommandLineFlags(int* argc, char*** argv,
     first_nonopt = 1;   // because we still don't count argv[0]
   }
 
-  logging_is_probably_set_up = true;   // because we've parsed --logdir, etc.
+  if (sandbox_ == NULL)  // a sandbox leaves process state alone
+    logging_is_probably_set_up = true;   // because we've parsed --logdir, etc.
 
   return first_nonopt;
 }
 
+// Whether the flagfile named filename is something other than a
+// regular file, so reading it may wait for input.
+static bool IsFlagfileStream(const string& filename) {
+  if (filename == "-")
+    return true;
+#if defined(HAVE_DIRENT_H)
+  struct stat st;
+  return stat(filename.c_str(), &st) == 0 && !S_ISREG(st.st_mode);
+#else
+  return false;
+#endif
+}
+
+void CommandLineFlagParser::PrefetchFlagfiles(int argc, char* const* argv) {
+  static const char kFlagfile[] = "flagfile";
+  const size_t flagfile_len = sizeof(kFlagfile) - 1;
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (arg[0] != '-' || arg[1] == '\0')
+      continue;                  // not a flag
+    arg++;                       // skip leading '-'
+    if (arg[0] == '-') arg++;    // or leading '--'
+    if (*arg == '\0')
+      break;                     // -- ends the flags
+    if (strncmp(arg, kFlagfile, flagfile_len) != 0)
+      continue;
+    const char* value;
+    if (arg[flagfile_len] == '=')
+      value = arg + flagfile_len + 1;
+    else if (arg[flagfile_len] == '\0' && i + 1 < argc)
+      value = argv[++i];         // --flagfile file
+    else
+      continue;
+    vector<string> filename_list;
+    ParseFlagList(value, &filename_list);
+    for (size_t j = 0; j < filename_list.size(); ++j) {
+      const string& file = filename_list[j];
+      // Named twice, it is read ahead once; the second --flagfile reads
+      // what is left of it, as it would have anyway.
+      if (prefetched_flagfiles_.count(file) > 0 || !IsFlagfileStream(file))
+        continue;
+      string contents;
+      bool ok;
+      if (file == "-") {
+        ok = ReadStreamIntoString(stdin, &contents);
+      } else {
+        ok = TryReadFileIntoString(file.c_str(), &contents);
+      }
+      // Errors are left to ProcessFlagfileLocked(), which meets them
+      // again when it reads the file itself.
+      if (ok)
+        prefetched_flagfiles_[file].swap(contents);
+    }
+  }
+}
+
 // 分别对参数中的每一个文件进行处理，如file1.txt,file2.txt,file3.txt
 string CommandLineFlagParser::ProcessFlagfileLocked(const string& flagval,
                                                     FlagSettingMode set_mode) {
@@ -1198,7 +2786,100 @@ string CommandLineFlagParser::ProcessFlagfileLocked(const string& flagval,
   ParseFlagList(flagval.c_str(), &filename_list);  // take a list of filenames
   for (size_t i = 0; i < filename_list.size(); ++i) {
     const char* file = filename_list[i].c_str();
-    msg += ProcessOptionsFromStringLocked(ReadFileIntoString(file), set_mode);
+    map<string, string>::iterator prefetched =
+        prefetched_flagfiles_.find(filename_list[i]);
+    if (prefetched != prefetched_flagfiles_.end()) {
+      string contents;
+      contents.swap(prefetched->second);
+      prefetched_flagfiles_.erase(prefetched);
+      msg += ProcessOptionsFromStringLocked(contents, set_mode);
+      continue;
+    }
+    if (filename_list[i] == "-") {
+      msg += ProcessOptionsFromStreamLocked(stdin, "<stdin>", set_mode);
+      continue;
+    }
+    FILE* fp;
+    if ((errno = SafeFOpen(&fp, file, "r")) != 0) {
+      if (!validating_) PFATAL(file);
+      error_flags_[file] = StringPrintf("%scannot read flagfile '%s': %s\n",
+                                        kError, file, strerror(errno));
+      continue;
+    }
+    msg += ProcessOptionsFromStreamLocked(fp, file, set_mode);
+    fclose(fp);
+  }
+  return msg;
+}
+
+// Lists the names in dir, in sorted order, leaving out hidden entries
+// (which includes "." and "..", and the "..data" links that Kubernetes
+// puts in projected volumes).  Returns false and sets errno on failure.
+static bool ListFlagdir(const string& dir, vector<string>* names) {
+#if defined(HAVE_DIRENT_H)
+  DIR* d = opendir(dir.c_str());
+  if (d == NULL)
+    return false;
+  for (const struct dirent* entry; (entry = readdir(d)) != NULL; ) {
+    if (entry->d_name[0] != '.')
+      names->push_back(entry->d_name);
+  }
+  closedir(d);
+  sort(names->begin(), names->end());
+  return true;
+#else
+  (void)dir;
+  (void)names;
+  errno = ENOSYS;
+  return false;
+#endif
+}
+
+// Each file in a --flagdir directory holds the value of the flag it is
+// named after, the layout of a Kubernetes ConfigMap mounted as a volume.
+// Only files named after a flag are read; as in flagfiles, other names
+// are silently ignored.
+string CommandLineFlagParser::ProcessFlagdirLocked(const string& flagval,
+                                                   FlagSettingMode set_mode) {
+  if (flagval.empty())
+    return "";
+
+  string msg;
+  vector<string> dir_list;
+  ParseFlagList(flagval.c_str(), &dir_list);  // take a list of directories
+  for (size_t i = 0; i < dir_list.size(); ++i) {
+    vector<string> names;
+    if (!ListFlagdir(dir_list[i], &names)) {
+      if (!validating_) PFATAL(dir_list[i].c_str());
+      error_flags_[dir_list[i]] =
+          StringPrintf("%scannot read flagdir '%s': %s\n",
+                       kError, dir_list[i].c_str(), strerror(errno));
+      continue;
+    }
+    for (size_t j = 0; j < names.size(); ++j) {
+      CommandLineFlag* flag = registry_->FindActiveFlagLocked(names[j].c_str());
+      if (flag == NULL)
+        continue;
+      const string path = dir_list[i] + "/" + names[j];
+#if defined(HAVE_DIRENT_H)
+      struct stat st;
+      if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        continue;   // a subdirectory, or a dangling link
+#endif
+      string value;
+      if (!TryReadFileIntoString(path.c_str(), &value)) {
+        if (!validating_) PFATAL(path.c_str());
+        error_flags_[path] =
+            StringPrintf("%scannot read flagdir file '%s': %s\n",
+                         kError, path.c_str(), strerror(errno));
+        continue;
+      }
+      // Values usually come with a trailing newline; it isn't part of them.
+      while (!value.empty() && (value[value.size() - 1] == '\n' ||
+                                value[value.size() - 1] == '\r'))
+        value.erase(value.size() - 1);
+      msg += ProcessSingleOptionLocked(flag, value.c_str(), set_mode);
+    }
   }
   return msg;
 }
@@ -1216,7 +2897,7 @@ string CommandLineFlagParser::ProcessFromenvLocked(const string& flagval,
 
   for (size_t i = 0; i < flaglist.size(); ++i) {
     const char* flagname = flaglist[i].c_str();
-    CommandLineFlag* flag = registry_->FindFlagLocked(flagname);
+    CommandLineFlag* flag = registry_->FindActiveFlagLocked(flagname);
     if (flag == NULL) {
       error_flags_[flagname] =
           StringPrintf("%sunknown command line flag '%s' "
@@ -1254,7 +2935,9 @@ string CommandLineFlagParser::ProcessFromenvLocked(const string& flagval,
 string CommandLineFlagParser::ProcessSingleOptionLocked(
     CommandLineFlag* flag, const char* value, FlagSettingMode set_mode) {
   string msg;
-  if (value && !registry_->SetFlagLocked(flag, value, set_mode, &msg)) {
+  if (limits_ != NULL && !AllowedInRestrictedModeLocked(flag, value))
+    return "";
+  if (value && !SetFlagLocked(flag, value, set_mode, &msg)) {
     error_flags_[flag->name()] = msg;
     return "";
   }
@@ -1264,16 +2947,21 @@ string CommandLineFlagParser::ProcessSingleOptionLocked(
   // messages of their own.
   // 格式：--flagfile=config.txt,config2.txt
   if (strcmp(flag->name(), "flagfile") == 0) {
-    msg += ProcessFlagfileLocked(FLAGS_flagfile, set_mode);
+    msg += ProcessFlagfileLocked(StringFlagValue(FLAGS_flagfile), set_mode);
+
+  } else if (strcmp(flag->name(), "flagdir") == 0) {
+    msg += ProcessFlagdirLocked(StringFlagValue(FLAGS_flagdir), set_mode);
 
   } else if (strcmp(flag->name(), "fromenv") == 0) {
     // last arg indicates envval-not-found is fatal (unlike in --tryfromenv)
     // FLAGS_fromenv用于设置哪些flag从环境变量中获取值，例如FLAGS_fromenv=flag1,flag2,flag3
     // 这是就要从环境变量中获取flag1,flag2,flag3的值，所以要根据name在注册表中找到当前的flag
-    msg += ProcessFromenvLocked(FLAGS_fromenv, set_mode, true);
+    msg += ProcessFromenvLocked(StringFlagValue(FLAGS_fromenv), set_mode,
+                                true);
 
   } else if (strcmp(flag->name(), "tryfromenv") == 0) {
-    msg += ProcessFromenvLocked(FLAGS_tryfromenv, set_mode, false);
+    msg += ProcessFromenvLocked(StringFlagValue(FLAGS_tryfromenv), set_mode,
+                                false);
   }
 
   return msg;
@@ -1284,6 +2972,10 @@ void CommandLineFlagParser::ValidateFlags(bool all) {
   FlagRegistryLock frl(registry_);
   for (FlagRegistry::FlagConstIterator i = registry_->flags_.begin();
        i != registry_->flags_.end(); ++i) {
+    if (FlagRegistry::IsAlias(i))
+      continue;
+    if (!registry_->IsActiveLocked(i->second))
+      continue;   // flags of other subcommands are not validated
     if ((all || !i->second->Modified()) && !i->second->ValidateCurrent()) {
       // only set a message if one isn't already there.  (If there's
       // an error message, our job is done, even if it's not exactly
@@ -1309,147 +3001,334 @@ void CommandLineFlagParser::ValidateUnmodifiedFlags() {
 
 // 将可以忽略的错误信息从error_flags_中删除，然后将剩下的错误信息打印出来
 bool CommandLineFlagParser::ReportErrors() {
+  string error_message;
+  const bool found_error = CollectErrors(&error_message);
+  if (found_error)
+    ReportError(DO_NOT_DIE, "%s", error_message.c_str());
+  return found_error;
+}
+
+bool CommandLineFlagParser::CollectErrors(string* error_message) {
   // error_flags_ indicates errors we saw while parsing.
   // But we ignore undefined-names if ok'ed by --undef_ok
   // FLAGS_undefok代表一系列可以被忽略的未定义的flag
-  if (!FLAGS_undefok.empty()) {
+  set<string> undefok;
+  const string& undefok_flags = StringFlagValue(FLAGS_undefok);
+  if (!undefok_flags.empty()) {
     vector<string> flaglist;
-    ParseFlagList(FLAGS_undefok.c_str(), &flaglist);
-    for (size_t i = 0; i < flaglist.size(); ++i) {
-      // We also deal with --no<flag>, in case the flagname was boolean
+    ParseFlagList(undefok_flags.c_str(), &flaglist);
+    undefok.insert(flaglist.begin(), flaglist.end());
+  }
+  if (!undefined_names_.empty()) {
+    FlagRegistryLock frl(registry_);
+    for (map<string, string>::const_iterator it = undefined_names_.begin();
+         it != undefined_names_.end();  ++it) {
+      const string& name = it->first;
+      // We also deal with --no<flag>, in case the flagname was boolean.
+      // Likewise, if they decided to allow reparsing, all undefined-names
+      // are ok; we just silently ignore them now, and hope that a future
+      // parse will pick them up somehow.
       // 对于bool类型的flag，可以在flag前加上no，表示将其设置为false，例如：--noflag表示将flag设置为false
-      const string no_version = string("no") + flaglist[i];
-      // 检查flaglist中的每一个flag是否在undefined_names_中，如果在，则将其从error_flags_中删除
-      if (undefined_names_.find(flaglist[i]) != undefined_names_.end()) {
-        error_flags_[flaglist[i]] = "";    // clear the error message
-      } else if (undefined_names_.find(no_version) != undefined_names_.end()) {
-        error_flags_[no_version] = "";
+      if (allow_command_line_reparsing
+          || undefok.count(name) > 0
+          || (name.compare(0, 2, "no") == 0
+              && undefok.count(name.substr(2)) > 0)) {
+        error_flags_[name] = "";         // clear the error message
+      } else if (error_flags_.find(name) == error_flags_.end()) {
+        // Seen on the commandline; now we know the message will be shown.
+        string key;
+        const char* value;
+        registry_->SplitArgumentLocked(name.c_str(), &key, &value,
+                                       &error_flags_[name]);
       }
     }
   }
-  // Likewise, if they decided to allow reparsing, all undefined-names
-  // are ok; we just silently ignore them now, and hope that a future
-  // parse will pick them up somehow.
-  if (allow_command_line_reparsing) {
-    for (map<string, string>::const_iterator it = undefined_names_.begin();
-         it != undefined_names_.end();  ++it)
-      error_flags_[it->first] = "";      // clear the error message
-  }
 
   bool found_error = false;
-  string error_message;
   for (map<string, string>::const_iterator it = error_flags_.begin();
        it != error_flags_.end(); ++it) {
     if (!it->second.empty()) {
-      error_message.append(it->second.data(), it->second.size());
+      error_message->append(it->second.data(), it->second.size());
       found_error = true;
     }
   }
-  if (found_error)
-    ReportError(DO_NOT_DIE, "%s", error_message.c_str());
   return found_error;
 }
 
+// If line is a flagfile section header, "[name]" where name is made of
+// the characters of flag names (or is empty), sets *name and returns
+// true.  Anything else, such as a glob like "[a-z]*", is not a header.
+static bool ParseSectionLine(const string& line, string* name) {
+  if (line.empty() || line[0] != '[')
+    return false;
+  size_t close = 1;
+  while (close < line.size() &&
+         (isalnum(static_cast<unsigned char>(line[close])) ||
+          line[close] == '_'))
+    ++close;
+  if (close == line.size() || line[close] != ']')
+    return false;
+  for (size_t i = close + 1; i < line.size(); ++i) {
+    if (!isspace(static_cast<unsigned char>(line[i])))
+      return false;
+  }
+  name->assign(line, 1, close - 1);
+  return true;
+}
+
+void CommandLineFlagParser::FindSectionFlagsLocked(FlagfileState* state) {
+  state->section_flags.clear();
+  if (state->section_prefix.empty())
+    return;
+  vector<CommandLineFlag*> flags;
+  registry_->FindFlagsWithPrefixLocked(state->section_prefix.c_str(), &flags);
+  const size_t prefix_len = state->section_prefix.size();
+  for (size_t i = 0; i < flags.size(); ++i)
+    state->section_flags[flags[i]->name() + prefix_len] = flags[i];
+}
+
+void CommandLineFlagParser::IgnoreFlagfileLine(const CommandLineFlag* flag,
+                                               const string& key) {
+  if (!validating_)
+    return;
+  if (flag == NULL) {
+    undefined_names_[key] = "";   // reported as unknown unless --undefok
+  } else {
+    error_flags_[key] = StringPrintf("%sflag '%s' is missing its value\n",
+                                     kError, key.c_str());
+  }
+}
+
+string CommandLineFlagParser::ScheduleOptionLocked(
+    const char* time_and_flag) {
+  const bool relative = (*time_and_flag == '+');
+  char* end;
+  const double when = strtod(time_and_flag + relative, &end);
+  if (end == time_and_flag + relative || !isspace(*end))
+    return "";                      // silently ignored, like other errors
+  const char* name_and_val = end;
+  while (isspace(*name_and_val))
+    ++name_and_val;
+  if (*name_and_val++ != '-')
+    return "";
+  if (*name_and_val == '-')
+    name_and_val++;
+  string key;
+  const char* value;
+  CommandLineFlag* flag = registry_->SplitArgumentLocked(name_and_val,
+                                                         &key, &value, NULL);
+  if (flag == NULL || value == NULL) {
+    IgnoreFlagfileLine(flag, key);
+    return "";
+  }
+  if (limits_ != NULL) {
+    error_flags_[flag->name()] =
+        StringPrintf("%sflag '%s' may not be scheduled in a restricted"
+                     " update\n", kError, flag->name());
+    return "";
+  }
+  if (sandbox_ != NULL) {
+    error_flags_[flag->name()] =
+        StringPrintf("%sflag '%s' may not be scheduled in a sandbox\n",
+                     kError, flag->name());
+    return "";
+  }
+  if (!flag->CanParse(value)) {
+    error_flags_[flag->name()] =
+        StringPrintf("%sillegal value '%s' specified for %s flag '%s'\n",
+                     kError, value, flag->type_name(), flag->name());
+    return "";
+  }
+  if (validating_)
+    return "";   // the value is fine; don't actually schedule it
+  if (!ScheduleChange(flag->name(), value, relative, when)) {
+    error_flags_[flag->name()] =
+        StringPrintf("%scannot schedule changes to flag '%s'\n",
+                     kError, flag->name());
+    return "";
+  }
+  return StringPrintf("%s scheduled to be set to %s\n", flag->name(), value);
+}
+
 // 处理一个文件中的所有命令行
 string CommandLineFlagParser::ProcessOptionsFromStringLocked(
     const string& contentdata, FlagSettingMode set_mode) {
   string retval;
+  FlagfileState state;
   const char* flagfile_contents = contentdata.c_str();
-  bool flags_are_relevant = true;   // set to false when filenames don't match
-  bool in_filename_section = false;
-
-  const char* line_end = flagfile_contents;
-  // We read this file a line at a time.
-  for (; line_end; flagfile_contents = line_end + 1) {
-    // 跳过空白字符
-    while (*flagfile_contents && isspace(*flagfile_contents))
-      ++flagfile_contents;
-    // Windows uses "\r\n"
-    // '\r'是回车符，'\n'是换行符
-    line_end = strchr(flagfile_contents, '\r');
+  const char* const contents_end = flagfile_contents + contentdata.size();
+
+  // We read this file a line at a time.  Windows uses "\r\n", so either
+  // character ends a line; the other then shows up as an empty line.
+  while (flagfile_contents < contents_end) {
+    const char* line_end = strpbrk(flagfile_contents, "\r\n");
     if (line_end == NULL)
-        line_end = strchr(flagfile_contents, '\n');
-
-    size_t len = line_end ? line_end - flagfile_contents
-                          : strlen(flagfile_contents);
-    // line是一个flagfile中的一行
-    string line(flagfile_contents, len);
-
-    // Each line can be one of four things:
-    // 1) A comment line -- we skip it
-    // 2) An empty line -- we skip it
-    // 3) A list of filenames -- starts a new filenames+flags section
-    // 4) A --flag=value line -- apply if previous filenames match
-
-    // 示例：file1.cpp file2.cpp file3.cpp
-    //        --optimize=2
-    //        --debug
-    //      file4.cpp
-    //        --optimize=3
-    //        --warnings=all
-    if (line.empty() || line[0] == '#') {
-      // comment or empty line; just ignore
-
-    } else if (line[0] == '-') {    // flag
-      in_filename_section = false;  // instead, it was a flag-line
-      if (!flags_are_relevant)      // skip this flag; applies to someone else
-        continue;
+      line_end = contents_end;
+    retval += ProcessOptionLineLocked(flagfile_contents,
+                                      line_end - flagfile_contents,
+                                      &state, set_mode);
+    flagfile_contents = line_end + 1;
+  }
+  return retval;
+}
 
-      const char* name_and_val = line.c_str() + 1;    // skip the leading -
-      if (*name_and_val == '-')
-        name_and_val++;                               // skip second - too
-      string key;
-      const char* value;
-      string error_message;
-      CommandLineFlag* flag = registry_->SplitArgumentLocked(name_and_val,
-                                                             &key, &value,
-                                                             &error_message);
-      // By API, errors parsing flagfile lines are silently ignored.
-      if (flag == NULL) {
-        // "WARNING: flagname '" + key + "' not found\n"
-      } else if (value == NULL) {
-        // "WARNING: flagname '" + key + "' missing a value\n"
+string CommandLineFlagParser::ProcessOptionsFromStreamLocked(
+    FILE* fp, const char* filename, FlagSettingMode set_mode) {
+  string retval;
+  FlagfileState state;
+  string partial;   // start of a line longer than the buffer
+  char buffer[8192];
+
+  // fgets() returns as soon as a line is complete, so a flagfile fed
+  // through a pipe (other than those PrefetchFlagfiles() read ahead)
+  // is applied as it arrives rather than at EOF.
+  while (fgets(buffer, sizeof(buffer), fp) != NULL) {
+    const char* p = buffer;
+    const char* const end = buffer + strlen(buffer);
+    for (const char* eol; (eol = strpbrk(p, "\r\n")) != NULL; p = eol + 1) {
+      if (partial.empty()) {
+        retval += ProcessOptionLineLocked(p, eol - p, &state, set_mode);
       } else {
-        // 正常处理此flag
-        // 如果正在解析的文件中仍然出现了flagfile、fromenv或tryfromenv，则递归处理
-        retval += ProcessSingleOptionLocked(flag, value, set_mode);
+        partial.append(p, eol - p);
+        retval += ProcessOptionLineLocked(partial.data(), partial.size(),
+                                          &state, set_mode);
+        partial.clear();
       }
+    }
+    partial.append(p, end - p);
+  }
+  if (ferror(fp)) {
+    if (!validating_) PFATAL(filename);
+    error_flags_[filename] = StringPrintf("%scannot read flagfile '%s': %s\n",
+                                          kError, filename, strerror(errno));
+  }
+  if (!partial.empty())   // last line had no newline
+    retval += ProcessOptionLineLocked(partial.data(), partial.size(),
+                                      &state, set_mode);
+  return retval;
+}
 
-    } else {                        // a filename!
-      if (!in_filename_section) {   // start over: assume filenames don't match
-        in_filename_section = true;
-        flags_are_relevant = false;
+string CommandLineFlagParser::ProcessOptionLineLocked(
+    const char* line_start, size_t len, FlagfileState* state,
+    FlagSettingMode set_mode) {
+  // 跳过空白字符
+  while (len > 0 && isspace(*line_start)) {
+    ++line_start;
+    --len;
+  }
+  // line是一个flagfile中的一行
+  const string line(line_start, len);
+  string section;
+
+  // Each line can be one of six things:
+  // 1) A comment line -- we skip it
+  // 2) An empty line -- we skip it
+  // 3) A list of filenames -- starts a new filenames+flags section
+  // 4) A --flag=value line -- apply if previous filenames match
+  // 5) A [prefix] line -- starts a section of prefix_-scoped flags;
+  //    [] ends it
+  // 6) A name=value line in such a section -- like --prefix_name=value
+  // 7) An @time --flag=value line -- schedules the change for later
+
+  // 示例：file1.cpp file2.cpp file3.cpp
+  //        --optimize=2
+  //        --debug
+  //      file4.cpp
+  //        --optimize=3
+  //        --warnings=all
+  //      [storage_cache]
+  //        size=64
+  //      @1767232800 --optimize=1
+  //      @+30 --debug=false
+  if (line.empty() || line[0] == '#') {
+    // comment or empty line; just ignore
+
+  } else if (ParseSectionLine(line, &section)) {   // section
+    state->in_filename_section = false;
+    state->section_prefix = section.empty() ? section : section + "_";
+    FindSectionFlagsLocked(state);
+
+  } else if (line[0] == '@') {      // scheduled flag
+    state->in_filename_section = false;
+    if (state->flags_are_relevant)
+      return ScheduleOptionLocked(line.c_str() + 1);
+
+  } else if (line[0] == '-' ||
+             (!state->section_prefix.empty()
+              && line.find('=') != string::npos)) {  // flag
+    state->in_filename_section = false;  // instead, it was a flag-line
+    if (!state->flags_are_relevant)  // skip this flag; applies to someone else
+      return "";
+
+    string scoped_line;
+    const char* name_and_val;
+    if (line[0] == '-') {
+      name_and_val = line.c_str() + 1;              // skip the leading -
+      if (*name_and_val == '-')
+        name_and_val++;                             // skip second - too
+    } else {
+      // Most section lines name a flag of the section exactly; others,
+      // such as aliases or names with dashes, take the long way below.
+      const size_t eq = line.find('=');
+      map<string, CommandLineFlag*>::const_iterator section_flag =
+          state->section_flags.find(line.substr(0, eq));
+      if (section_flag != state->section_flags.end() &&
+          registry_->IsActiveLocked(section_flag->second)) {
+        return ProcessSingleOptionLocked(section_flag->second,
+                                         line.c_str() + eq + 1, set_mode);
       }
+      scoped_line = state->section_prefix + line;
+      name_and_val = scoped_line.c_str();
+    }
+    string key;
+    const char* value;
+    CommandLineFlag* flag = registry_->SplitArgumentLocked(name_and_val,
+                                                           &key, &value,
+                                                           NULL);
+    // By API, errors parsing flagfile lines are silently ignored.
+    if (flag == NULL || value == NULL) {
+      IgnoreFlagfileLine(flag, key);
+    } else {
+      // 正常处理此flag
+      // 如果正在解析的文件中仍然出现了flagfile、fromenv或tryfromenv，则递归处理
+      return ProcessSingleOptionLocked(flag, value, set_mode);
+    }
 
-      // Split the line up at spaces into glob-patterns
-      const char* space = line.c_str();   // just has to be non-NULL
-      // 对一行中的每一个单词进行处理
-      for (const char* word = line.c_str(); *space; word = space+1) {
-        if (flags_are_relevant)     // we can stop as soon as we match
-          break;
-        // space指针用于定位下一个空格，以便将当前行分割成多个单词
-        space = strchr(word, ' ');
-        if (space == NULL)
-          space = word + strlen(word);
-        const string glob(word, space - word);
-        // We try matching both against the full argv0 and basename(argv0)
-        // 如果当前的文件名与glob匹配，则flags_are_relevant设置为true
-        if (glob == ProgramInvocationName()       // small optimization
-            || glob == ProgramInvocationShortName()
+  } else {                        // a filename!
+    if (!state->in_filename_section) {  // start over: assume no match
+      state->in_filename_section = true;
+      state->flags_are_relevant = false;
+      state->section_prefix.clear();
+    }
+
+    // Split the line up at spaces into glob-patterns
+    const char* space = line.c_str();   // just has to be non-NULL
+    // 对一行中的每一个单词进行处理
+    for (const char* word = line.c_str(); *space; word = space+1) {
+      if (state->flags_are_relevant)  // we can stop as soon as we match
+        break;
+      // space指针用于定位下一个空格，以便将当前行分割成多个单词
+      space = strchr(word, ' ');
+      if (space == NULL)
+        space = word + strlen(word);
+      const string glob(word, space - word);
+      // We try matching both against the full argv0 and basename(argv0)
+      // 如果当前的文件名与glob匹配，则flags_are_relevant设置为true
+      if (glob == ProgramInvocationName()       // small optimization
+          || glob == ProgramInvocationShortName()
 #if defined(HAVE_FNMATCH_H)
-            || fnmatch(glob.c_str(), ProgramInvocationName(),      FNM_PATHNAME) == 0
-            || fnmatch(glob.c_str(), ProgramInvocationShortName(), FNM_PATHNAME) == 0
+          || fnmatch(glob.c_str(), ProgramInvocationName(),      FNM_PATHNAME) == 0
+          || fnmatch(glob.c_str(), ProgramInvocationShortName(), FNM_PATHNAME) == 0
 #elif defined(HAVE_SHLWAPI_H)
-            || PathMatchSpecA(glob.c_str(), ProgramInvocationName())
-            || PathMatchSpecA(glob.c_str(), ProgramInvocationShortName())
+          || PathMatchSpecA(glob.c_str(), ProgramInvocationName())
+          || PathMatchSpecA(glob.c_str(), ProgramInvocationShortName())
 #endif
-            ) {
-          flags_are_relevant = true;
-        }
+          ) {
+        state->flags_are_relevant = true;
       }
     }
   }
-  return retval;
+  return "";
 }
 
 // --------------------------------------------------------------------
@@ -1515,7 +3394,10 @@ bool AddFlagValidator(const void* flag_ptr, ValidateFnProto validate_fn_proto) {
 //    don't have a destructor that deletes flag_, because that would
 //    cause us to delete current_storage/defvalue_storage as well,
 //    which can cause a crash if anything tries to access the flag
-//    values in a global destructor.
+//    values in a global destructor.  Nor does it unregister the flag:
+//    static destructors also run when the program exits, and flags
+//    must stay usable from the destructors run after them.  Plugins
+//    call UnregisterFlagsFromModule() before they are unloaded.
 // --------------------------------------------------------------------
 
 // 匿名命名空间，仅在本文件中有效，意味着这个函数只能在本文件中调用，可能是一些辅助函数
@@ -1524,12 +3406,13 @@ void RegisterCommandLineFlag(const char* name,
                              const char* help,
                              const char* filename,
                              FlagValue* current,
-                             FlagValue* defvalue) {
+                             FlagValue* defvalue,
+                             Derivation* derivation = NULL) {
   if (help == NULL)
     help = "";
   // Importantly, flag_ will never be deleted, so storage is always good.
-  CommandLineFlag* flag =
-      new CommandLineFlag(name, help, filename, current, defvalue);
+  CommandLineFlag* flag = new CommandLineFlag(name, help, filename,
+                                              current, defvalue, derivation);
   FlagRegistry::GlobalRegistry()->RegisterFlag(flag);  // default registry
 }
 }
@@ -1548,11 +3431,40 @@ FlagRegisterer::FlagRegisterer(const char* name,
   RegisterCommandLineFlag(name, help, filename, current, defvalue);
 }
 
+// The type-specific parts of a Derivation.
+template <typename FlagType>
+static void ComputeDerivedValue(void* value, void (*compute)()) {
+  *static_cast<FlagType*>(value) =
+      reinterpret_cast<FlagType (*)()>(compute)();
+}
+
+template <typename FlagType>
+static void AssignDerivedValue(void* to, const void* from) {
+  *static_cast<FlagType*>(to) = *static_cast<const FlagType*>(from);
+}
+
+template <typename FlagType>
+FlagRegisterer::FlagRegisterer(const char* name,
+                               const char* help,
+                               const char* filename,
+                               const char* dependencies,
+                               DerivedFlag<FlagType>* flag) {
+  FlagValue* const current = new FlagValue(&flag->value_, false);
+  FlagValue* const defvalue = new FlagValue(new FlagType(flag->value_), true);
+  Derivation* const derivation = new Derivation(
+      dependencies, reinterpret_cast<void (*)()>(flag->compute_),
+      &ComputeDerivedValue<FlagType>, &AssignDerivedValue<FlagType>);
+  RegisterCommandLineFlag(name, help, filename, current, defvalue, derivation);
+}
+
 // Force compiler to generate code for the given template specialization.
 #define INSTANTIATE_FLAG_REGISTERER_CTOR(type)                  \
   template GFLAGS_DLL_DECL FlagRegisterer::FlagRegisterer(      \
       const char* name, const char* help, const char* filename, \
-      type* current_storage, type* defvalue_storage)
+      type* current_storage, type* defvalue_storage);           \
+  template GFLAGS_DLL_DECL FlagRegisterer::FlagRegisterer(      \
+      const char* name, const char* help, const char* filename, \
+      const char* dependencies, DerivedFlag<type>* flag)
 
 // Do this for all supported flag types.
 // 为不同的数据类型实例化，意味着对每一种不同的类，编译器都会生成一个对应的FlagRegisterer类
@@ -1566,6 +3478,21 @@ INSTANTIATE_FLAG_REGISTERER_CTOR(std::string);
 
 #undef INSTANTIATE_FLAG_REGISTERER_CTOR
 
+FlagRegisterer::FlagRegisterer(const char* name,
+                               const char* help,
+                               const char* filename,
+                               fLS::LazyString* storage) {
+  FlagValue* const current = new FlagValue(storage, false);
+  FlagValue* const defvalue = new FlagValue(storage, true);
+  RegisterCommandLineFlag(name, help, filename, current, defvalue);
+}
+
+FlagAliasRegisterer::FlagAliasRegisterer(const char* alias,
+                                         const char* target,
+                                         bool deprecated) {
+  FlagRegistry::GlobalRegistry()->RegisterAlias(alias, target, deprecated);
+}
+
 // --------------------------------------------------------------------
 // GetAllFlags()
 //    The main way the FlagRegistry class exposes its data.  This
@@ -1585,19 +3512,64 @@ struct FilenameFlagnameCmp {
 };
 
 // 将GlobalRegistry中所有的flag信息存入OUTPUT中，然后按照文件名和flag名进行排序
+// Orders flags by the interned names of their files, which need no
+// comparison when they are the same.
+struct FlagFileCmp {
+  bool operator()(const CommandLineFlag* a, const CommandLineFlag* b) const {
+    return (a->filename() != b->filename() &&
+            strcmp(a->filename(), b->filename()) < 0);
+  }
+};
+
 void GetAllFlags(vector<CommandLineFlagInfo>* OUTPUT) {
+  const bool append = !OUTPUT->empty();
   FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
   // 使用互斥锁保证同一时间只有一个线程访问registry
   registry->Lock();
+  vector<CommandLineFlag*> flags;
+  flags.reserve(registry->flags_by_ptr_.size());
   for (FlagRegistry::FlagConstIterator i = registry->flags_.begin();
        i != registry->flags_.end(); ++i) {
-    CommandLineFlagInfo fi;
-    i->second->FillCommandLineFlagInfo(&fi);
-    OUTPUT->push_back(fi);
+    if (FlagRegistry::IsAlias(i) || !registry->IsActiveLocked(i->second))
+      continue;   // an alias is listed as the flag it stands for
+    flags.push_back(i->second);
+  }
+  // Now sort the flags, first by filename they occur in, then
+  // alphabetically.  flags_ is sorted by name already, so a stable
+  // sort by file does it, moving pointers rather than
+  // CommandLineFlagInfos.
+  stable_sort(flags.begin(), flags.end(), FlagFileCmp());
+  OUTPUT->reserve(OUTPUT->size() + flags.size());
+  for (size_t i = 0; i < flags.size(); ++i) {
+    registry->RefreshDerivedLocked(flags[i]);
+    OUTPUT->push_back(CommandLineFlagInfo());
+    flags[i]->FillCommandLineFlagInfo(&OUTPUT->back());
   }
   registry->Unlock();
-  // Now sort the flags, first by filename they occur in, then alphabetically
-  sort(OUTPUT->begin(), OUTPUT->end(), FilenameFlagnameCmp());
+  if (append)   // merge with what the caller had already
+    sort(OUTPUT->begin(), OUTPUT->end(), FilenameFlagnameCmp());
+}
+
+int ForEachFlagWithPrefix(const char* prefix,
+                          void (*fn)(const CommandLineFlagInfo& flag, void* arg),
+                          void* arg) {
+  vector<CommandLineFlagInfo> infos;
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  {
+    FlagRegistryLock frl(registry);
+    vector<CommandLineFlag*> flags;
+    registry->FindFlagsWithPrefixLocked(prefix, &flags);
+    for (size_t i = 0; i < flags.size(); ++i) {
+      if (!registry->IsActiveLocked(flags[i]))
+        continue;   // like GetAllFlags()
+      registry->RefreshDerivedLocked(flags[i]);
+      infos.push_back(CommandLineFlagInfo());
+      flags[i]->FillCommandLineFlagInfo(&infos.back());
+    }
+  }
+  for (size_t i = 0; i < infos.size(); ++i)
+    fn(infos[i], arg);
+  return static_cast<int>(infos.size());
 }
 
 // --------------------------------------------------------------------
@@ -1617,8 +3589,16 @@ void GetAllFlags(vector<CommandLineFlagInfo>* OUTPUT) {
 // These values are not protected by a Mutex because they are normally
 // set only once during program startup.
 static string argv0("UNKNOWN");  // just the program name
-static string cmdline;           // the entire command-line
+static string argv_contents;     // each of argv, NUL-terminated, back to back
+static int argv_count = 0;
 static string program_usage;
+
+// The rest of the argv bookkeeping is derived from argv_contents the
+// first time somebody asks for it, so programs that never do (and those
+// with huge commandlines) don't pay for it in ParseCommandLineFlags().
+static Mutex argv_lock(Mutex::LINKER_INITIALIZED);
+static bool argv_derived = false;  // true once the values below are set
+static string cmdline;             // the entire command-line
 static vector<string> argvs;
 static uint32 argv_sum = 0;
 
@@ -1633,11 +3613,30 @@ void SetArgv(int argc, const char** argv) {
   assert(argc > 0); // every program h.as at least a name
   argv0 = argv[0];
 
+  MutexLock l(&argv_lock);
+  argv_contents.clear();
+  for (int i = 0; i < argc; i++)
+    argv_contents.append(argv[i], strlen(argv[i]) + 1);   // with the NUL
+  argv_count = argc;
+  argv_derived = false;
+}
+
+// Fills in cmdline, argvs and argv_sum from argv_contents, unless that
+// has been done already.
+static void DeriveArgvLocked() {
+  if (argv_derived) return;
+  argv_derived = true;
+
   cmdline.clear();
-  for (int i = 0; i < argc; i++) {
+  argvs.clear();
+  argvs.reserve(argv_count);
+  const char* arg = argv_contents.c_str();
+  for (int i = 0; i < argv_count; i++) {
     if (i != 0) cmdline += " ";
-    cmdline += argv[i];
-    argvs.push_back(argv[i]);
+    const size_t len = strlen(arg);
+    cmdline.append(arg, len);
+    argvs.push_back(string(arg, len));
+    arg += len + 1;
   }
 
   // Compute a simple sum of all the chars in argv
@@ -1648,10 +3647,22 @@ void SetArgv(int argc, const char** argv) {
   }
 }
 
-const vector<string>& GetArgvs() { return argvs; }
-const char* GetArgv()            { return cmdline.c_str(); }
+const vector<string>& GetArgvs() {
+  MutexLock l(&argv_lock);
+  DeriveArgvLocked();
+  return argvs;
+}
+const char* GetArgv() {
+  MutexLock l(&argv_lock);
+  DeriveArgvLocked();
+  return cmdline.c_str();
+}
 const char* GetArgv0()           { return argv0.c_str(); }
-uint32 GetArgvSum()              { return argv_sum; }
+uint32 GetArgvSum() {
+  MutexLock l(&argv_lock);
+  DeriveArgvLocked();
+  return argv_sum;
+}
 // 返回程序的名字
 const char* ProgramInvocationName() {             // like the GNU libc fn
   return GetArgv0();
@@ -1724,6 +3735,7 @@ bool GetCommandLineOption(const char* name, string* value) {
   if (flag == NULL) {
     return false;
   } else {
+    registry->RefreshDerivedLocked(flag);
     *value = flag->current_value();
     return true;
   }
@@ -1739,11 +3751,25 @@ bool GetCommandLineFlagInfo(const char* name, CommandLineFlagInfo* OUTPUT) {
     return false;
   } else {
     assert(OUTPUT);
+    registry->RefreshDerivedLocked(flag);
     flag->FillCommandLineFlagInfo(OUTPUT);
     return true;
   }
 }
 
+bool ReadDerivedFlag(const void* flag_ptr, void* value) {
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistryIfExists();
+  if (registry == NULL)
+    return false;
+  FlagRegistryLock frl(registry);
+  CommandLineFlag* flag = registry->FindFlagViaPtrLocked(flag_ptr);
+  if (flag == NULL || flag->derivation_ == NULL)
+    return false;
+  registry->RefreshDerivedLocked(flag);
+  flag->derivation_->assign(value, flag_ptr);
+  return true;
+}
+
 CommandLineFlagInfo GetCommandLineFlagInfoOrDie(const char* name) {
   CommandLineFlagInfo info;
   if (!GetCommandLineFlagInfo(name, &info)) {
@@ -1774,75 +3800,282 @@ string SetCommandLineOption(const char* name, const char* value) {
   return SetCommandLineOptionWithMode(name, value, SET_FLAGS_VALUE);
 }
 
-// --------------------------------------------------------------------
-// FlagSaver
-// FlagSaverImpl
-//    This class stores the states of all flags at construct time,
-//    and restores all flags to that state at destruct time.
-//    Its major implementation challenge is that it never modifies
-//    pointers in the 'main' registry, so global FLAG_* vars always
-//    point to the right place.
-// --------------------------------------------------------------------
-
-class FlagSaverImpl {
- public:
-  // Constructs an empty FlagSaverImpl object.
-  explicit FlagSaverImpl(FlagRegistry* main_registry)
-      : main_registry_(main_registry) { }
-  ~FlagSaverImpl() {
-    // reclaim memory from each of our CommandLineFlags
-    vector<CommandLineFlag*>::const_iterator it;
-    for (it = backup_registry_.begin(); it != backup_registry_.end(); ++it)
-      delete *it;
-  }
+bool GetCommandLineOptionGeneration(const char* name, string* value,
+                                    uint64* generation) {
+  if (NULL == name)
+    return false;
+  assert(value);
+  assert(generation);
 
-  // Saves the flag states from the flag registry into this object.
-  // It's an error to call this more than once.
-  // Must be called when the registry mutex is not held.
-  // 将main_registry_中的所有flag的信息备份到backup_registry_中
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  FlagRegistryLock frl(registry);
+  CommandLineFlag* flag = registry->FindFlagLocked(name);
+  if (flag == NULL)
+    return false;
+  registry->RefreshDerivedLocked(flag);
+  *value = flag->current_value();
+  *generation = flag->generation();
+  return true;
+}
+
+bool CompareAndSetCommandLineOption(const char* name, const char* expected,
+                                    const char* desired) {
+  if (NULL == name)
+    return false;
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  FlagRegistryLock frl(registry);
+  CommandLineFlag* flag = registry->FindFlagLocked(name);
+  if (flag == NULL || !flag->HasValue(expected))
+    return false;
+  CommandLineFlagParser parser(registry);
+  return !parser.ProcessSingleOptionLocked(flag, desired,
+                                           SET_FLAGS_VALUE).empty();
+}
+
+bool CompareAndSetCommandLineOptionGeneration(const char* name,
+                                              uint64 expected_generation,
+                                              const char* desired) {
+  if (NULL == name)
+    return false;
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  FlagRegistryLock frl(registry);
+  CommandLineFlag* flag = registry->FindFlagLocked(name);
+  if (flag == NULL || flag->generation() != expected_generation)
+    return false;
+  CommandLineFlagParser parser(registry);
+  return !parser.ProcessSingleOptionLocked(flag, desired,
+                                           SET_FLAGS_VALUE).empty();
+}
+
+string SetFlagsWithPrefix(const char* prefix, const char* value,
+                          FlagSettingMode set_mode) {
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  CommandLineFlagParser parser(registry);
+  string result;
+  {
+    FlagRegistryLock frl(registry);
+    vector<CommandLineFlag*> flags;
+    registry->FindFlagsWithPrefixLocked(prefix, &flags);
+    for (size_t i = 0; i < flags.size(); ++i)
+      result += parser.ProcessSingleOptionLocked(flags[i], value, set_mode);
+  }
+  string errors;
+  parser.CollectErrors(&errors);   // e.g. a word for an int32 flag
+  return result + errors;
+}
+
+// --------------------------------------------------------------------
+// ScheduleFlagChange()
+// ScheduleFlagChangeAfter()
+//    Check the flag and value now, then leave the change to the
+//    FlagChangeScheduler thread.
+// --------------------------------------------------------------------
+
+static bool ScheduleFlagChangeIfValid(const char* name, const char* value,
+                                      bool relative, double when) {
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  {
+    FlagRegistryLock frl(registry);
+    const CommandLineFlag* flag = registry->FindFlagLocked(name);
+    if (flag == NULL || !flag->CanParse(value))
+      return false;
+  }
+  return ScheduleChange(name, value, relative, when);
+}
+
+bool ScheduleFlagChange(const char* name, const char* value, int64 when) {
+  return ScheduleFlagChangeIfValid(name, value, false,
+                                   static_cast<double>(when));
+}
+
+bool ScheduleFlagChangeAfter(const char* name, const char* value,
+                             double delay_seconds) {
+  return ScheduleFlagChangeIfValid(name, value, true, delay_seconds);
+}
+
+// --------------------------------------------------------------------
+// FlagSaver
+// FlagSaverImpl
+//    This class stores the states of all flags at construct time,
+//    and restores all flags to that state at destruct time.
+//    Its major implementation challenge is that it never modifies
+//    pointers in the 'main' registry, so global FLAG_* vars always
+//    point to the right place.
+// --------------------------------------------------------------------
+
+class FlagSaverImpl {
+ public:
+  // Constructs an empty FlagSaverImpl object.
+  explicit FlagSaverImpl(FlagRegistry* main_registry)
+      : main_registry_(main_registry) { }
+  ~FlagSaverImpl() {
+    if (!backup_registry_.empty()) {
+      FlagRegistryLock frl(main_registry_);
+      main_registry_->RemoveSaverLocked(this);
+    }
+    // reclaim memory from each of our CommandLineFlags
+    BackupMap::const_iterator it;
+    for (it = backup_registry_.begin(); it != backup_registry_.end(); ++it)
+      delete it->second;
+  }
+
+  // Saves the flag states from the flag registry into this object.
+  // It's an error to call this more than once.
+  // Must be called when the registry mutex is not held.
+  // 将main_registry_中的所有flag的信息备份到backup_registry_中
   void SaveFromRegistry() {
     FlagRegistryLock frl(main_registry_);
     assert(backup_registry_.empty());   // call only once!
     for (FlagRegistry::FlagConstIterator it = main_registry_->flags_.begin();
          it != main_registry_->flags_.end();
          ++it) {
-      const CommandLineFlag* main = it->second;
-      // Sets up all the const variables in backup correctly
-      // 备份每一个flag的信息
-      CommandLineFlag* backup = new CommandLineFlag(
-          main->name(), main->help(), main->filename(),
-          main->current_->New(), main->defvalue_->New());
-      // Sets up all the non-const variables in backup correctly
-      backup->CopyFrom(*main);
-      backup_registry_.push_back(backup);   // add it to a convenient list
-    }
-  }
-
-  // Restores the saved flag states into the flag registry.  We
-  // assume no flags were added or deleted from the registry since
-  // the SaveFromRegistry; if they were, that's trouble!  Must be
-  // called when the registry mutex is not held.
+      if (!FlagRegistry::IsAlias(it))
+        BackupFlag(it->second);
+    }
+    if (!backup_registry_.empty())
+      main_registry_->AddSaverLocked(this);
+  }
+
+  // Saves the flags in the subtree named by prefix, as documented for
+  // ForEachFlagWithPrefix().  Call instead of SaveFromRegistry().
+  // Must be called when the registry mutex is not held.
+  void SaveFromRegistryWithPrefix(const char* prefix) {
+    FlagRegistryLock frl(main_registry_);
+    assert(backup_registry_.empty());   // call only once!
+    vector<CommandLineFlag*> flags;
+    main_registry_->FindFlagsWithPrefixLocked(prefix, &flags);
+    for (size_t i = 0; i < flags.size(); ++i)
+      SaveFlagLocked(flags[i]);
+  }
+
+  // Saves the state of just one flag, unless it has been saved already.
+  // Lets callers that change only a few flags undo their changes
+  // without copying the whole registry.  Don't mix with
+  // SaveFromRegistry().  Must be called with the registry mutex held.
+  void SaveFlagLocked(const CommandLineFlag* main) {
+    if (backup_registry_.find(main) != backup_registry_.end())
+      return;
+    if (backup_registry_.empty())
+      main_registry_->AddSaverLocked(this);
+    BackupFlag(main);
+  }
+
+  // Restores the saved flag states into the flag registry.  Flags
+  // added since the SaveFromRegistry are left alone, and flags
+  // removed since then have already been dropped by ForgetFlagLocked.
+  // Must be called when the registry mutex is not held.
   // 将backup_registry_中的所有flag的信息恢复到main_registry_中
   void RestoreToRegistry() {
     FlagRegistryLock frl(main_registry_);
-    vector<CommandLineFlag*>::const_iterator it;
+    BackupMap::const_iterator it;
     for (it = backup_registry_.begin(); it != backup_registry_.end(); ++it) {
-      CommandLineFlag* main = main_registry_->FindFlagLocked((*it)->name());
-      if (main != NULL) {       // if NULL, flag got deleted from registry(!)
-        main->CopyFrom(**it);
-      }
+      const_cast<CommandLineFlag*>(it->first)->CopyFrom(*it->second);
+    }
+    ++main_registry_->generation_;   // derived flags have to check
+  }
+
+  // Drops the backup of a flag that is being unregistered, so we
+  // never touch it (or its name, which may be about to be unmapped)
+  // again.  Must be called with the registry mutex held.
+  void ForgetFlagLocked(const CommandLineFlag* main) {
+    BackupMap::iterator it = backup_registry_.find(main);
+    if (it != backup_registry_.end()) {
+      delete it->second;
+      backup_registry_.erase(it);
     }
   }
 
  private:
+  // 备份每一个flag的信息
+  void BackupFlag(const CommandLineFlag* main) {
+    // Sets up all the const variables in backup correctly
+    CommandLineFlag* backup = new CommandLineFlag(
+        main->name(), main->help(), main->filename(),
+        main->current_->New(), main->defvalue_->New());
+    // Sets up all the non-const variables in backup correctly.  Not
+    // with CopyFrom(), which would tell the CachedStringFlags of main
+    // that it changed.
+    backup->modified_ = main->modified_;
+    backup->current_->CopyFrom(*main->current_);
+    backup->defvalue_->CopyFrom(*main->defvalue_);
+    backup->validate_fn_proto_ = main->validate_fn_proto_;
+    backup_registry_[main] = backup;   // add it to a convenient map
+  }
+
   FlagRegistry* const main_registry_;
   // 因为不能直接修改main_registry_中的CommandLineFlag对象，所以需要一个备份
-  vector<CommandLineFlag*> backup_registry_;
+  // Maps each flag of main_registry_ to its backup.
+  typedef map<const CommandLineFlag*, CommandLineFlag*> BackupMap;
+  BackupMap backup_registry_;
 
   FlagSaverImpl(const FlagSaverImpl&);  // no copying!
   void operator=(const FlagSaverImpl&);
 };
 
+// Defined here rather than with the rest of FlagRegistry since it
+// needs the complete FlagSaverImpl.
+void FlagRegistry::UnregisterFlagLocked(CommandLineFlag* flag) {
+  name_index_built_ = false;
+  name_hash_built_ = false;
+  ++flags_generation_;
+  if (flag->Type() == FlagValue::FV_STRING)
+    BumpStringFlagsRemoved();
+  flags_.erase(flag->name());
+  // Its aliases stay known, ready for a flag of the same name.
+  pair<AliasTargetMap::iterator, AliasTargetMap::iterator> range =
+      aliases_by_target_.equal_range(flag->name());
+  for (AliasTargetMap::iterator i = range.first; i != range.second; ++i)
+    flags_.erase(i->second);
+  flags_by_ptr_.erase(flag->flag_ptr());
+  if (module_index_built_) {
+    pair<FlagModuleMap::iterator, FlagModuleMap::iterator> range =
+        flags_by_module_.equal_range(flag->module_);
+    for (FlagModuleMap::iterator i = range.first; i != range.second; ++i) {
+      if (i->second == flag) {
+        flags_by_module_.erase(i);
+        break;
+      }
+    }
+  }
+  for (set<FlagSaverImpl*>::const_iterator i = savers_.begin();
+       i != savers_.end(); ++i) {
+    (*i)->ForgetFlagLocked(flag);
+  }
+  delete flag;
+}
+
+// Defined here rather than with the rest of CommandLineFlagParser
+// since it needs the complete FlagSaverImpl.
+bool CommandLineFlagParser::AllowedInRestrictedModeLocked(
+    CommandLineFlag* flag, const char* value) {
+  if (strcmp(flag->name(), "flagfile") == 0 ||
+      strcmp(flag->name(), "flagdir") == 0 ||
+      strcmp(flag->name(), "fromenv") == 0 ||
+      strcmp(flag->name(), "tryfromenv") == 0) {
+    error_flags_[flag->name()] =
+        StringPrintf("%sflag '%s' is not allowed in a restricted update\n",
+                     kError, flag->name());
+    return false;
+  }
+  if (value == NULL)
+    return false;
+  if (++flags_set_ > limits_->max_flags) {
+    error_flags_[flag->name()] =
+        StringPrintf("%smore than %lu flags in a restricted update\n",
+                     kError,
+                     static_cast<unsigned long>(limits_->max_flags));
+    return false;
+  }
+  if (strlen(value) > limits_->max_value_length) {
+    error_flags_[flag->name()] =
+        StringPrintf("%svalue for flag '%s' is longer than %lu bytes\n",
+                     kError, flag->name(),
+                     static_cast<unsigned long>(limits_->max_value_length));
+    return false;
+  }
+  return true;
+}
+
 // 在构造时将所有的flag信息备份到backup_registry_中，在析构时将backup_registry_中的信息恢复到main_registry_中
 // 防止在main_registry_中的flag信息被修改后，无法恢复
 FlagSaver::FlagSaver()
@@ -1850,12 +4083,407 @@ FlagSaver::FlagSaver()
   impl_->SaveFromRegistry();
 }
 
+FlagSaver::FlagSaver(const char* prefix)
+    : impl_(new FlagSaverImpl(FlagRegistry::GlobalRegistry())) {
+  impl_->SaveFromRegistryWithPrefix(prefix);
+}
+
 FlagSaver::~FlagSaver() {
   impl_->RestoreToRegistry();
   delete impl_;
 }
 
 
+// --------------------------------------------------------------------
+// CachedStringFlag
+//    Each thread keeps its own copy of the value, along with the
+//    string_generation_ of the flag it was made at, and
+//    string_flags_removed, which tells whether that flag is gone.  All CachedStringFlags
+//    share one thread-local slot, holding a table of the thread's
+//    copies indexed by the table slot of each CachedStringFlag, so
+//    any number of them can exist without running out of keys.  Table
+//    slots are reused; a copy also records the serial number of the
+//    CachedStringFlag it was made for, so a copy left behind by a
+//    destroyed one is never taken for the value of another.
+// --------------------------------------------------------------------
+
+class CachedStringFlagImpl {
+ public:
+  struct Copy {
+    Copy() : serial(0), removed(0), flag_generation(NULL), generation(0) { }
+    uint64 serial;       // of the CachedStringFlagImpl, or 0 if unfilled
+    long removed;        // string_flags_removed
+    // The string_generation_ of the flag, or NULL if it is not
+    // registered, in which case every Get() copies the value again.
+    const volatile long* flag_generation;
+    long generation;     // *flag_generation
+    string value;
+  };
+
+  CachedStringFlagImpl() {
+    MutexLock l(&SlotsLock());
+    SlotTable& slots = Slots();
+    if (!slots.key_created) {
+      CreateKey();
+      slots.key_created = true;
+    }
+    if (slots.free.empty()) {
+      slot_ = slots.size++;
+    } else {
+      slot_ = slots.free.back();
+      slots.free.pop_back();
+    }
+    serial_ = ++slots.last_serial;
+  }
+  ~CachedStringFlagImpl() {
+    MutexLock l(&SlotsLock());
+    Slots().free.push_back(slot_);
+  }
+
+  uint64 serial() const { return serial_; }
+
+  // The calling thread's copy, whose serial is not ours if it has
+  // not been filled for us yet.
+  Copy* ThisThreadsCopy() {
+    CopyTable* table = Table();
+    if (table == NULL) {
+      table = new CopyTable;
+      SetTable(table);
+    }
+    if (table->size() <= slot_)
+      table->resize(slot_ + 1, NULL);
+    Copy*& copy = (*table)[slot_];
+    if (copy == NULL)
+      copy = new Copy;
+    return copy;
+  }
+
+ private:
+  typedef vector<Copy*> CopyTable;
+
+  struct SlotTable {
+    SlotTable() : key_created(false), size(0), last_serial(0) { }
+    bool key_created;
+    size_t size;              // slots handed out so far
+    vector<size_t> free;      // of destroyed CachedStringFlags
+    uint64 last_serial;
+  };
+  static Mutex& SlotsLock() {
+    static Mutex lock(Mutex::LINKER_INITIALIZED);
+    return lock;
+  }
+  static SlotTable& Slots() {
+    static SlotTable* slots = new SlotTable;   // never deleted
+    return *slots;
+  }
+
+  static void DeleteTable(void* table) {
+    CopyTable* const copies = static_cast<CopyTable*>(table);
+    for (size_t i = 0; i < copies->size(); ++i)
+      delete (*copies)[i];
+    delete copies;
+  }
+
+#if defined(NO_THREADS)
+  static CopyTable*& TheTable() {
+    static CopyTable* table = NULL;
+    return table;
+  }
+  static void CreateKey() { }
+  static CopyTable* Table() { return TheTable(); }
+  static void SetTable(CopyTable* table) { TheTable() = table; }
+#elif defined(OS_WINDOWS)
+  // Windows has no destructors for thread-local slots, so the tables
+  // of threads that exit are leaked.
+  static DWORD& Key() {
+    static DWORD key;
+    return key;
+  }
+  static void CreateKey() {
+    Key() = TlsAlloc();
+    if (Key() == TLS_OUT_OF_INDEXES) {
+      ReportError(DIE, "ERROR: out of thread-local storage slots\n");
+    }
+  }
+  static CopyTable* Table() {
+    return static_cast<CopyTable*>(TlsGetValue(Key()));
+  }
+  static void SetTable(CopyTable* table) { TlsSetValue(Key(), table); }
+#elif defined(HAVE_PTHREAD)
+  static pthread_key_t& Key() {
+    static pthread_key_t key;
+    return key;
+  }
+  static void CreateKey() {
+    if (pthread_key_create(&Key(), &DeleteTable) != 0) {
+      ReportError(DIE, "ERROR: out of thread-local storage keys\n");
+    }
+  }
+  static CopyTable* Table() {
+    return static_cast<CopyTable*>(pthread_getspecific(Key()));
+  }
+  static void SetTable(CopyTable* table) { pthread_setspecific(Key(), table); }
+#endif
+
+  size_t slot_;     // in the table of each thread
+  uint64 serial_;   // unique among all CachedStringFlagImpls ever made
+
+  CachedStringFlagImpl(const CachedStringFlagImpl&);   // no copying!
+  void operator=(const CachedStringFlagImpl&);
+};
+
+CachedStringFlag::CachedStringFlag(const string* flag)
+    : flag_(flag), impl_(new CachedStringFlagImpl) {
+}
+
+CachedStringFlag::~CachedStringFlag() {
+  delete impl_;
+}
+
+const string& CachedStringFlag::Get() const {
+  CachedStringFlagImpl::Copy* const copy = impl_->ThisThreadsCopy();
+  // The flag is only looked at while no string flag was removed
+  // since, so it can't have been deleted.
+  if (copy->serial == impl_->serial() &&
+      copy->removed == LoadStringFlagsRemoved() &&
+      copy->flag_generation != NULL &&
+      copy->generation == AtomicLoad(copy->flag_generation))
+    return copy->value;
+  // Writers hold the registry lock, so the value can't tear under it.
+  copy->flag_generation = NULL;
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistryIfExists();
+  if (registry != NULL) {
+    FlagRegistryLock frl(registry);
+    copy->removed = LoadStringFlagsRemoved();
+    CommandLineFlag* const flag = registry->FindFlagViaPtrLocked(flag_);
+    if (flag != NULL) {
+      copy->flag_generation = &flag->string_generation_;
+      copy->generation = AtomicLoad(copy->flag_generation);
+    }
+    copy->value = *flag_;
+  } else {
+    copy->value = *flag_;
+  }
+  copy->serial = impl_->serial();
+  return copy->value;
+}
+
+
+// --------------------------------------------------------------------
+// FlagSandbox
+// FlagSandboxImpl
+//    A sandbox maps the current-value pointer of each flag set in it
+//    to a value of its own.  The sandbox of a thread is kept in a
+//    thread-local slot, which GetFlag() only looks at once a Scope was
+//    ever entered, so programs without sandboxes pay an atomic load.
+// --------------------------------------------------------------------
+
+class FlagSandboxImpl {
+ public:
+  FlagSandboxImpl() { }
+  ~FlagSandboxImpl() {
+    for (size_t i = 0; i < all_values_.size(); ++i)
+      delete all_values_[i];
+  }
+
+  // Sets the flag in this sandbox, like FlagRegistry::SetFlagLocked()
+  // with SET_FLAGS_VALUE.
+  bool SetFlagLocked(const CommandLineFlag* flag, const char* value,
+                     string* msg) {
+    if (flag->derivation_ != NULL) {
+      if (msg) {
+        *msg = StringPrintf("%sflag '%s' is derived from other flags and "
+                            "cannot be set\n", kError, flag->name());
+      }
+      return false;
+    }
+    FlagValue* const sandboxed = flag->current_->New();
+    if (!TryParseLocked(flag, sandboxed, value, msg, NULL)) {
+      delete sandboxed;
+      return false;
+    }
+    all_values_.push_back(sandboxed);
+    WriterMutexLock l(&values_lock_);
+    values_[flag->flag_ptr()] = sandboxed;
+    return true;
+  }
+
+  // Returns where the value of the flag whose FLAGS_ variable is at
+  // flag_ptr is in this sandbox: flag_ptr itself, unless it was set.
+  // May be called without the registry lock.
+  const void* Resolve(const void* flag_ptr) const {
+    ReaderMutexLock l(&values_lock_);
+    ValueMap::const_iterator i = values_.find(flag_ptr);
+    return i == values_.end() ? flag_ptr : i->second->value_buffer_;
+  }
+
+  string CurrentValueLocked(const CommandLineFlag* flag) const {
+    ValueMap::const_iterator i = values_.find(flag->flag_ptr());
+    return i == values_.end() ? flag->current_value() : i->second->ToString();
+  }
+
+ private:
+  // The current value of each flag set in the sandbox.  Values are
+  // never changed once set, and setting a flag again only makes
+  // values_ point elsewhere, so GetFlag() references stay valid as long
+  // as the sandbox.  Changes to values_ are made with the registry lock
+  // held, but Resolve() reads it from the threads of the sandbox too.
+  typedef map<const void*, FlagValue*> ValueMap;
+  ValueMap values_;
+  mutable Mutex values_lock_;
+  vector<FlagValue*> all_values_;            // every value ever set
+
+  FlagSandboxImpl(const FlagSandboxImpl&);   // no copying!
+  void operator=(const FlagSandboxImpl&);
+};
+
+// Set to 1, for good, when the first Scope creates the slot.
+static volatile long sandbox_slot_created = 0;
+
+#if defined(NO_THREADS)
+static const FlagSandboxImpl* current_sandbox = NULL;
+static void CreateSandboxSlot() { }
+static const FlagSandboxImpl* CurrentSandbox() { return current_sandbox; }
+static void SetCurrentSandbox(const FlagSandboxImpl* sandbox) {
+  current_sandbox = sandbox;
+}
+#elif defined(OS_WINDOWS)
+static DWORD sandbox_key;
+static void CreateSandboxSlot() {
+  sandbox_key = TlsAlloc();
+  if (sandbox_key == TLS_OUT_OF_INDEXES) {
+    ReportError(DIE, "ERROR: out of thread-local storage slots\n");
+  }
+}
+static const FlagSandboxImpl* CurrentSandbox() {
+  return static_cast<const FlagSandboxImpl*>(TlsGetValue(sandbox_key));
+}
+static void SetCurrentSandbox(const FlagSandboxImpl* sandbox) {
+  TlsSetValue(sandbox_key, const_cast<FlagSandboxImpl*>(sandbox));
+}
+#elif defined(HAVE_PTHREAD)
+static pthread_key_t sandbox_key;
+static void CreateSandboxSlot() {
+  if (pthread_key_create(&sandbox_key, NULL) != 0) {
+    ReportError(DIE, "ERROR: out of thread-local storage keys\n");
+  }
+}
+static const FlagSandboxImpl* CurrentSandbox() {
+  return static_cast<const FlagSandboxImpl*>(pthread_getspecific(sandbox_key));
+}
+static void SetCurrentSandbox(const FlagSandboxImpl* sandbox) {
+  pthread_setspecific(sandbox_key, sandbox);
+}
+#endif
+
+static const void* ResolveInCurrentSandbox(const void* flag_ptr) {
+  if (AtomicLoad(&sandbox_slot_created) == 0)
+    return flag_ptr;
+  const FlagSandboxImpl* const sandbox = CurrentSandbox();
+  return sandbox == NULL ? flag_ptr : sandbox->Resolve(flag_ptr);
+}
+
+#define GFLAGS_DEFINE_GET_FLAG(type)                                        \
+  const type& GetFlag(const type& flag) {                                   \
+    return *static_cast<const type*>(ResolveInCurrentSandbox(&flag));       \
+  }
+
+GFLAGS_DEFINE_GET_FLAG(bool)
+GFLAGS_DEFINE_GET_FLAG(int32)
+GFLAGS_DEFINE_GET_FLAG(uint32)
+GFLAGS_DEFINE_GET_FLAG(int64)
+GFLAGS_DEFINE_GET_FLAG(uint64)
+GFLAGS_DEFINE_GET_FLAG(double)
+GFLAGS_DEFINE_GET_FLAG(string)
+
+#undef GFLAGS_DEFINE_GET_FLAG
+
+FlagSandbox::FlagSandbox() : impl_(new FlagSandboxImpl) {
+}
+
+FlagSandbox::~FlagSandbox() {
+  delete impl_;
+}
+
+uint32 FlagSandbox::ParseCommandLineFlags(int* argc, char*** argv,
+                                          bool remove_flags, string* errors) {
+  CommandLineFlagParser parser(FlagRegistry::GlobalRegistry());
+  parser.Sandbox(impl_);
+  const uint32 r = parser.ParseNewCommandLineFlags(argc, argv, remove_flags);
+  string error_message;
+  parser.CollectErrors(&error_message);
+  if (errors != NULL)
+    errors->swap(error_message);
+  return r;
+}
+
+bool FlagSandbox::GetCommandLineOption(const char* name,
+                                       string* OUTPUT) const {
+  if (NULL == name)
+    return false;
+  assert(OUTPUT);
+
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  FlagRegistryLock frl(registry);
+  CommandLineFlag* flag = registry->FindFlagLocked(name);
+  if (flag == NULL)
+    return false;
+  registry->RefreshDerivedLocked(flag);
+  *OUTPUT = impl_->CurrentValueLocked(flag);
+  return true;
+}
+
+string FlagSandbox::SetCommandLineOption(const char* name, const char* value) {
+  string result;
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  FlagRegistryLock frl(registry);
+  CommandLineFlag* flag = registry->FindFlagLocked(name);
+  if (flag) {
+    CommandLineFlagParser parser(registry);
+    parser.Sandbox(impl_);
+    result = parser.ProcessSingleOptionLocked(flag, value, SET_FLAGS_VALUE);
+  }
+  return result;
+}
+
+FlagSandbox::Scope::Scope(const FlagSandbox& sandbox) {
+  if (AtomicLoad(&sandbox_slot_created) == 0) {
+    static Mutex lock(Mutex::LINKER_INITIALIZED);
+    MutexLock acquire_lock(&lock);
+    if (AtomicLoad(&sandbox_slot_created) == 0) {
+      CreateSandboxSlot();
+      AtomicIncrement(&sandbox_slot_created);
+    }
+  }
+  previous_ = CurrentSandbox();
+  SetCurrentSandbox(sandbox.impl_);
+}
+
+FlagSandbox::Scope::~Scope() {
+  SetCurrentSandbox(previous_);
+}
+
+// Defined here rather than with the rest of CommandLineFlagParser
+// since they need the complete FlagSandboxImpl.
+bool CommandLineFlagParser::SetFlagLocked(CommandLineFlag* flag,
+                                          const char* value,
+                                          FlagSettingMode set_mode,
+                                          string* msg) {
+  if (sandbox_ == NULL) {
+    if (undo_ != NULL)
+      undo_->SaveFlagLocked(flag);   // restricted or validation mode
+    return registry_->SetFlagLocked(flag, value, set_mode, msg);
+  }
+  return sandbox_->SetFlagLocked(flag, value, msg);   // just SET_FLAGS_VALUE
+}
+
+const string& CommandLineFlagParser::StringFlagValue(const string& flag) const {
+  if (sandbox_ == NULL)
+    return flag;
+  return *static_cast<const string*>(sandbox_->Resolve(&flag));
+}
+
+
 // --------------------------------------------------------------------
 // CommandlineFlagsIntoString()
 // ReadFlagsFromString()
@@ -1886,6 +4514,8 @@ static string TheseCommandlineFlagsIntoString(
   string retval;
   retval.reserve(retval_space);
   for (i = flags.begin(); i != flags.end(); ++i) {
+    if (!i->derived_from.empty())
+      continue;   // could not be read back
     retval += "--";
     retval += i->name;
     retval += "=";
@@ -1926,6 +4556,117 @@ bool ReadFlagsFromString(const string& flagfilecontents,
   return true;
 }
 
+FlagUpdateLimits::FlagUpdateLimits()
+    : max_input_bytes(64 << 10), max_flags(1000), max_value_length(4 << 10) {
+}
+
+bool ReadFlagsFromStringRestricted(const string& flagfilecontents,
+                                   const FlagUpdateLimits& limits) {
+  if (flagfilecontents.size() > limits.max_input_bytes) {
+    ReportError(DO_NOT_DIE,
+                "ERROR: restricted update of %lu bytes exceeds the limit"
+                " of %lu bytes\n",
+                static_cast<unsigned long>(flagfilecontents.size()),
+                static_cast<unsigned long>(limits.max_input_bytes));
+    return false;
+  }
+
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  FlagSaverImpl saved_states(registry);   // only saves flags as they change
+
+  CommandLineFlagParser parser(registry);
+  parser.Restrict(&limits, &saved_states);
+  registry->Lock();
+  parser.ProcessOptionsFromStringLocked(flagfilecontents, SET_FLAGS_VALUE);
+  registry->Unlock();
+  if (parser.ReportErrors()) {
+    saved_states.RestoreToRegistry();
+    return false;
+  }
+  return true;
+}
+
+// Appends the report lines for file, one per line of errors.
+static void AppendValidationReport(const string& file, const string& errors,
+                                   string* report) {
+  if (errors.empty()) {
+    *report += file + "\tOK\n";
+    return;
+  }
+  const size_t error_len = sizeof(kError) - 1;
+  for (size_t pos = 0; pos < errors.size(); ) {
+    size_t end = errors.find('\n', pos);
+    if (end == string::npos)
+      end = errors.size();
+    size_t start = pos;
+    if (errors.compare(start, error_len, kError) == 0)
+      start += error_len;
+    if (end > start)
+      *report += file + "\tERROR\t" + errors.substr(start, end - start) + "\n";
+    pos = end + 1;
+  }
+}
+
+bool ValidateFlagfiles(const vector<string>& paths, string* report) {
+  vector<string> files;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    vector<string> names;
+    if (!ListFlagdir(paths[i], &names)) {
+      files.push_back(paths[i]);   // not a directory
+      continue;
+    }
+    for (size_t j = 0; j < names.size(); ++j) {
+      const string path = paths[i] + "/" + names[j];
+#if defined(HAVE_DIRENT_H)
+      struct stat st;
+      if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        continue;
+#endif
+      files.push_back(path);
+    }
+  }
+
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  // Each file gets the warnings of the deprecated aliases it uses, and
+  // the process keeps the warnings it had.
+  set<string> warned;
+  registry->Lock();
+  registry->SwapAliasWarningsLocked(&warned);
+  registry->Unlock();
+  bool all_valid = true;
+  for (size_t i = 0; i < files.size(); ++i) {
+    const char* const file = files[i].c_str();
+    // Each file starts from the flags as they were; only the flags it
+    // changes are backed up and restored.
+    FlagSaverImpl undo(registry);
+    CommandLineFlagParser parser(registry);
+    parser.Validate(&undo);
+    string errors;
+    FILE* fp;
+    if ((errno = SafeFOpen(&fp, file, "r")) != 0) {
+      errors = StringPrintf("%scannot read flagfile '%s': %s\n",
+                            kError, file, strerror(errno));
+    } else {
+      registry->Lock();
+      set<string> none;
+      registry->SwapAliasWarningsLocked(&none);
+      parser.ProcessOptionsFromStreamLocked(fp, file, SET_FLAGS_VALUE);
+      registry->Unlock();
+      fclose(fp);
+      parser.ValidateUnmodifiedFlags();   // the flags it left alone
+      parser.CollectErrors(&errors);   // before --undefok is restored
+    }
+    undo.RestoreToRegistry();
+    if (!errors.empty())
+      all_valid = false;
+    AppendValidationReport(files[i], errors, report);
+  }
+  registry->Lock();
+  registry->SwapAliasWarningsLocked(&warned);
+  registry->Unlock();
+  return all_valid;
+}
+
 // TODO(csilvers): nix prog_name in favor of ProgramInvocationShortName()
 // 将全部的flag信息转为string类型并写入到filename中
 bool AppendFlagsIntoFile(const string& filename, const char *prog_name) {
@@ -1940,12 +4681,15 @@ bool AppendFlagsIntoFile(const string& filename, const char *prog_name) {
 
   vector<CommandLineFlagInfo> flags;
   GetAllFlags(&flags);
-  // But we don't want --flagfile, which leads to weird recursion issues
+  // But we don't want --flagfile or --flagdir, which lead to weird
+  // recursion issues
   vector<CommandLineFlagInfo>::iterator i;
-  for (i = flags.begin(); i != flags.end(); ++i) {
-    if (strcmp(i->name.c_str(), "flagfile") == 0) {
-      flags.erase(i);
-      break;
+  for (i = flags.begin(); i != flags.end(); ) {
+    if (strcmp(i->name.c_str(), "flagfile") == 0 ||
+        strcmp(i->name.c_str(), "flagdir") == 0) {
+      i = flags.erase(i);
+    } else {
+      ++i;
     }
   }
   fprintf(fp, "%s", TheseCommandlineFlagsIntoString(flags).c_str());
@@ -2048,6 +4792,46 @@ bool RegisterFlagValidator(const string* flag,
                            bool (*validate_fn)(const char*, const string&)) {
   return AddFlagValidator(flag, reinterpret_cast<ValidateFnProto>(validate_fn));
 }
+bool RegisterFlagValidator(const fLS::LazyString* flag,
+                           bool (*validate_fn)(const char*, const string&)) {
+  return AddFlagValidator(flag, reinterpret_cast<ValidateFnProto>(validate_fn));
+}
+
+
+// --------------------------------------------------------------------
+// AddFlagToGroup()
+// SetActiveFlagGroup()
+//    Flag groups scope parsing, validation and help to the flags of
+//    one subcommand.  Grouping only stores an interned name with the
+//    flag, so it is as cheap as registering a validator.
+// --------------------------------------------------------------------
+
+bool AddFlagToGroup(const void* flag_ptr, const char* group) {
+  if (group == NULL || *group == '\0')
+    return false;
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  FlagRegistryLock frl(registry);
+  CommandLineFlag* flag = registry->FindFlagViaPtrLocked(flag_ptr);
+  if (!flag) {
+    LOG(WARNING) << "Ignoring AddFlagToGroup() for flag pointer "
+                 << flag_ptr << ": no flag found at that address";
+    return false;
+  }
+  const char* const interned = registry->InternGroupLocked(group);
+  if (flag->group_ != NULL && flag->group_ != interned) {
+    LOG(WARNING) << "Ignoring AddFlagToGroup() for flag '" << flag->name()
+                 << "': already in group '" << flag->group_ << "'";
+    return false;
+  }
+  flag->group_ = interned;
+  return true;
+}
+
+bool SetActiveFlagGroup(const char* group) {
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  FlagRegistryLock frl(registry);
+  return registry->SetActiveGroupLocked(group);
+}
 
 
 // --------------------------------------------------------------------
@@ -2079,6 +4863,7 @@ static uint32 ParseCommandLineFlagsInternal(int* argc, char*** argv,
   registry->Lock();
   // FLAGS_flagfile的值是一个或多个文件名
   parser.ProcessFlagfileLocked(FLAGS_flagfile, SET_FLAGS_VALUE);
+  parser.ProcessFlagdirLocked(FLAGS_flagdir, SET_FLAGS_VALUE);
   // Last arg here indicates whether flag-not-found is a fatal error or not
   parser.ProcessFromenvLocked(FLAGS_fromenv, SET_FLAGS_VALUE, true);
   parser.ProcessFromenvLocked(FLAGS_tryfromenv, SET_FLAGS_VALUE, false);
@@ -2124,27 +4909,57 @@ void AllowCommandLineReparsing() {
   allow_command_line_reparsing = true;
 }
 
+void AllowCommandLineResponseFiles() {
+  allow_response_files = true;
+}
+
 // 重新解析命令行中的flag
 void ReparseCommandLineNonHelpFlags() {
   // We make a copy of argc and argv to pass in
   const vector<string>& argvs = GetArgvs();
-  int tmp_argc = static_cast<int>(argvs.size());
-  char** tmp_argv = new char* [tmp_argc + 1];
-  for (int i = 0; i < tmp_argc; ++i)
+  const int copy_argc = static_cast<int>(argvs.size());
+  char** const copy_argv = new char* [copy_argc + 1];
+  for (int i = 0; i < copy_argc; ++i)
     // strdup函数用于复制一个字符串，返回一个指向副本字符串的指针
-    tmp_argv[i] = strdup(argvs[i].c_str());   // TODO(csilvers): don't dup
+    copy_argv[i] = strdup(argvs[i].c_str());   // TODO(csilvers): don't dup
+  copy_argv[copy_argc] = NULL;
 
+  // Expanding @file arguments hands back a new array, whose words
+  // belong to the response files; only our copies are ours to free.
+  int tmp_argc = copy_argc;
+  char** tmp_argv = copy_argv;
   ParseCommandLineNonHelpFlags(&tmp_argc, &tmp_argv, false);
+  if (tmp_argv != copy_argv)
+    DeleteResponseFileArgv(tmp_argv);
 
   // free只是释放内存，与delete不同，delete会调用析构函数
-  for (int i = 0; i < tmp_argc; ++i)
-    free(tmp_argv[i]);
-  delete[] tmp_argv;
+  for (int i = 0; i < copy_argc; ++i)
+    free(copy_argv[i]);
+  delete[] copy_argv;
+}
+
+// --------------------------------------------------------------------
+// UnregisterFlagsFromModule()
+//    Forgets the flags of a shared library that is about to be
+//    unloaded.  The module of each flag is only looked up the first
+//    time this is called; after that, removal costs a lookup in the
+//    module index plus one erase per index for every flag removed.
+// --------------------------------------------------------------------
+
+int UnregisterFlagsFromModule(const void* address_in_module) {
+  const void* const module = ModuleOf(address_in_module);
+  if (module == NULL)
+    return 0;
+  FlagRegistry* const registry = FlagRegistry::GlobalRegistry();
+  FlagRegistryLock frl(registry);
+  return registry->UnregisterModuleLocked(module);
 }
 
 // 删除registry中的所有flag
 void ShutDownCommandLineFlags() {
+  ShutDownScheduledChanges();   // waits for a change being made
   FlagRegistry::DeleteGlobalRegistry();
+  DeleteResponseFiles();
 }
 
 
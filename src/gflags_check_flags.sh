@@ -0,0 +1,89 @@
+#!/bin/bash
+
+# Copyright (c) 2008, Google Inc.
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#
+#     * Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+# copyright notice, this list of conditions and the following disclaimer
+# in the documentation and/or other materials provided with the
+# distribution.
+#     * Neither the name of Google Inc. nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# ---
+#
+# Usage: gflags_check_flags.sh FILE...
+#
+# Checks that no flag is defined more than once in the given executables
+# and shared or static libraries, taken as the set of files that end up
+# in one process.  gflags only notices a duplicate flag once both are
+# registered, and then dies; this finds them at build or packaging time.
+#
+# The flag names of a file are read from its gflags_flag_names section
+# if it was compiled with -DGFLAGS_EMIT_FLAG_NAMES, which also works for
+# stripped files, and otherwise from the FLAGS_ symbols it exports.
+#
+# Prints one line per duplicate flag and exits with status 1 if there
+# are any, and with status 0 otherwise.
+
+if [ $# -eq 0 ] || [ "$1" = "-h" ] || [ "$1" = "--help" ]; then
+  echo "Usage: $0 FILE..." >&2
+  exit 2
+fi
+
+tmp=`mktemp` || exit 2
+trap 'rm -f "$tmp"' EXIT
+
+# Prints the names of the flags defined in file $1, one per line.
+flag_names() {
+  if objcopy -O binary --only-section=gflags_flag_names "$1" "$tmp" \
+         2>/dev/null && [ -s "$tmp" ]; then
+    tr '\0' '\n' < "$tmp" | grep -v '^$'
+  else
+    # A flag of every type lives in a namespace of its own (fLB, fLI,
+    # fLS, ...), so keep the namespace until the symbols are unique.
+    { nm -C --defined-only "$1"; nm -C -D --defined-only "$1"; } 2>/dev/null |
+      sed -n 's/^[0-9a-fA-F]* [BDGRSV] \(fL[A-Z0-9]*::FLAGS_[A-Za-z0-9_]*\)$/\1/p' |
+      sort -u | sed 's/^.*::FLAGS_//'
+  fi
+}
+
+for file in "$@"; do
+  if [ ! -r "$file" ]; then
+    echo "$0: cannot read '$file'" >&2
+    exit 2
+  fi
+done
+
+for file in "$@"; do
+  flag_names "$file" | sed "s|\$|	$file|"
+done | LC_ALL=C sort | awk -F '	' '
+  function report() {
+    if (count > 1) {
+      printf("ERROR: flag '\''%s'\'' was defined more than once (in %s).\n",
+             name, files);
+      status = 1;
+    }
+  }
+  $1 == name { files = files " and '\''" $2 "'\''"; ++count; next }
+  { report(); name = $1; files = "'\''" $2 "'\''"; count = 1 }
+  END { report(); exit status }'
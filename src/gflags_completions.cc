@@ -50,7 +50,6 @@
 #include <cstdlib>
 #include <cstring>   // for strlen
 
-#include <set>
 #include <string>
 #include <utility>
 #include <vector>
@@ -60,7 +59,6 @@
 #include "gflags/gflags_completions.h"
 #include "util.h"
 
-using std::set;
 using std::string;
 using std::vector;
 
@@ -82,7 +80,23 @@ namespace {
 // more easily understood if it is roughly ordered according to
 // control flow, rather than by C's "declare before use" ordering
 struct CompletionOptions;
-struct NotableFlags;
+struct CategorizedMatches;
+
+// Notable flags are flags that are special or preferred for some
+// reason.  For example, flags that are defined in the binary's module
+// are expected to be much more relevant than flags defined in some
+// other random location.  The categories are listed in precedence
+// order, which is also the order they are output in.  A flag is put
+// in the first category it qualifies for.
+enum FlagCategory {
+  PERFECT_MATCH_FLAG,
+  MODULE_FLAG,          // Found in module file
+  PACKAGE_FLAG,         // Found in same directory as module file
+  MOST_COMMON_FLAG,     // One of the XXX most commonly supplied flags
+  SUBPACKAGE_FLAG,      // Found in subdirectories of package
+  OTHER_FLAG,           // Not notable
+  NUM_FLAG_CATEGORIES
+};
 
 // The entry point if flag completion is to be used.
 static void PrintFlagCompletionInfo(void);
@@ -97,12 +111,15 @@ static void CanonicalizeCursorWordAndSearchOptions(
 static bool RemoveTrailingChar(string *str, char c);
 
 
-// 2) Find all matches
-static void FindMatchingFlags(
+// 2) Find all matches, 3) and categorize them
+static void FindAndCategorizeMatchingFlags(
     const vector<CommandLineFlagInfo> &all_flags,
     const CompletionOptions &options,
     const string &match_token,
-    set<const CommandLineFlagInfo *> *all_matches,
+    const string &module,
+    const string &package_dir,
+    size_t max_kept_per_category,
+    CategorizedMatches *matches,
     string *longest_common_prefix);
 
 static bool DoesSingleFlagMatch(
@@ -110,14 +127,11 @@ static bool DoesSingleFlagMatch(
     const CompletionOptions &options,
     const string &match_token);
 
-
-// 3) Categorize matches
-static void CategorizeAllMatchingFlags(
-    const set<const CommandLineFlagInfo *> &all_matches,
+static FlagCategory CategorizeFlag(
+    const CommandLineFlagInfo &flag,
     const string &search_token,
     const string &module,
-    const string &package_dir,
-    NotableFlags *notable_flags);
+    const string &package_dir);
 
 static void TryFindModuleAndPackageDir(
     const vector<CommandLineFlagInfo> &all_flags,
@@ -126,21 +140,17 @@ static void TryFindModuleAndPackageDir(
 
 
 // 4) Decide which flags to use
+static int MaxDesiredLines(const CompletionOptions &options);
+
 static void FinalizeCompletionOutput(
-    const set<const CommandLineFlagInfo *> &matching_flags,
+    const CategorizedMatches &matches,
     CompletionOptions *options,
-    NotableFlags *notable_flags,
     vector<string> *completions);
 
-static void RetrieveUnusedFlags(
-    const set<const CommandLineFlagInfo *> &matching_flags,
-    const NotableFlags &notable_flags,
-    set<const CommandLineFlagInfo *> *unused_flags);
-
 
 // 5) Output matches
 static void OutputSingleGroupWithLimit(
-    const set<const CommandLineFlagInfo *> &group,
+    const vector<const CommandLineFlagInfo *> &group,
     const string &line_indentation,
     const string &header,
     const string &footer,
@@ -202,19 +212,19 @@ struct CompletionOptions {
                        force_no_update(false) { }
 };
 
-// Notable flags are flags that are special or preferred for some
-// reason.  For example, flags that are defined in the binary's module
-// are expected to be much more relevant than flags defined in some
-// other random location.  These sets are specified roughly in precedence
-// order.  Once a flag is placed in one of these 'higher' sets, it won't
-// be placed in any of the 'lower' sets.
-struct NotableFlags {
-  typedef set<const CommandLineFlagInfo *> FlagSet;
-  FlagSet perfect_match_flag;
-  FlagSet module_flags;       // Found in module file
-  FlagSet package_flags;      // Found in same directory as module file
-  FlagSet most_common_flags;  // One of the XXX most commonly supplied flags
-  FlagSet subpackage_flags;   // Found in subdirectories of package
+// The matching flags of each category, in the order of GetAllFlags().
+// No more flags of a category are kept than can be output, so the
+// memory and time taken by a short completion word matching most of
+// the flags is bounded; count still tells how many matched.
+struct CategorizedMatches {
+  struct Category {
+    Category() : count(0) { }
+    size_t count;
+    vector<const CommandLineFlagInfo *> kept;
+  };
+  CategorizedMatches() : count(0) { }
+  size_t count;   // of all matches
+  Category categories[NUM_FLAG_CATEGORIES];
 };
 
 
@@ -235,19 +245,30 @@ static void PrintFlagCompletionInfo(void) {
   DVLOG(1) << "Identified canonical_token: '" << canonical_token << "'";
 
   vector<CommandLineFlagInfo> all_flags;
-  set<const CommandLineFlagInfo *> matching_flags;
   GetAllFlags(&all_flags);
   DVLOG(2) << "Found " << all_flags.size() << " flags overall";
 
+  // module是整个二进制文件的路径，package_dir是module的父目录
+  string module;
+  string package_dir;
+  // 3、找到所有flag中的模块文件和包目录，其中模块文件是filename，包目录是filename的父目录
+  TryFindModuleAndPackageDir(all_flags, &module, &package_dir);
+  DVLOG(1) << "Identified module: '" << module << "'";
+  DVLOG(1) << "Identified package_dir: '" << package_dir << "'";
+
+  CategorizedMatches matches;
   string longest_common_prefix;
-  // 2、找到所有与搜索词匹配的flag，并将其插入到matching_flags中，将这些flag的名字的最长公共前缀存储在longest_common_prefix中
-  FindMatchingFlags(
+  // 2、找到所有与搜索词匹配的flag并分类（完全匹配、模块匹配、包匹配、常用匹配和子包匹配），将这些flag的名字的最长公共前缀存储在longest_common_prefix中
+  FindAndCategorizeMatchingFlags(
       all_flags,
       options,
       canonical_token,
-      &matching_flags,
+      module,
+      package_dir,
+      MaxDesiredLines(options),  // no more flags of a category are shown
+      &matches,
       &longest_common_prefix);
-  DVLOG(1) << "Identified " << matching_flags.size() << " matching flags";
+  DVLOG(1) << "Identified " << matches.count << " matching flags";
   DVLOG(1) << "Identified " << longest_common_prefix
           << " as longest common prefix.";
   if (longest_common_prefix.size() > canonical_token.size()) {
@@ -259,39 +280,23 @@ static void PrintFlagCompletionInfo(void) {
     fprintf(stdout, "--%s", longest_common_prefix.c_str());
     return;
   }
-  if (matching_flags.empty()) {
+  if (matches.count == 0) {
     VLOG(1) << "There were no matching flags, returning nothing.";
     return;
   }
-  // module是整个二进制文件的路径，package_dir是module的父目录
-  string module;
-  string package_dir;
-  // 3、找到所有flag中的模块文件和包目录，其中模块文件是filename，包目录是filename的父目录
-  TryFindModuleAndPackageDir(all_flags, &module, &package_dir);
-  DVLOG(1) << "Identified module: '" << module << "'";
-  DVLOG(1) << "Identified package_dir: '" << package_dir << "'";
-
-  NotableFlags notable_flags;
-  // 4、将匹配的flag分为完全匹配、模块匹配、包匹配、常用匹配和子包匹配
-  CategorizeAllMatchingFlags(
-      matching_flags,
-      canonical_token,
-      module,
-      package_dir,
-      &notable_flags);
   DVLOG(2) << "Categorized matching flags:";
-  DVLOG(2) << " perfect_match: " << notable_flags.perfect_match_flag.size();
-  DVLOG(2) << " module: " << notable_flags.module_flags.size();
-  DVLOG(2) << " package: " << notable_flags.package_flags.size();
-  DVLOG(2) << " most common: " << notable_flags.most_common_flags.size();
-  DVLOG(2) << " subpackage: " << notable_flags.subpackage_flags.size();
+  DVLOG(2) << " perfect_match: "
+           << matches.categories[PERFECT_MATCH_FLAG].count;
+  DVLOG(2) << " module: " << matches.categories[MODULE_FLAG].count;
+  DVLOG(2) << " package: " << matches.categories[PACKAGE_FLAG].count;
+  DVLOG(2) << " most common: " << matches.categories[MOST_COMMON_FLAG].count;
+  DVLOG(2) << " subpackage: " << matches.categories[SUBPACKAGE_FLAG].count;
 
   vector<string> completions;
   // 5、将所有flag的信息输出到completions中，限制输出的行数不超过99行
   FinalizeCompletionOutput(
-      matching_flags,
+      matches,
       &options,
-      &notable_flags,
       &completions);
 
   if (options.force_no_update)
@@ -371,40 +376,47 @@ static bool RemoveTrailingChar(string *str, char c) {
 
 
 // 2) Find all matches (and helper methods)
-// 遍历所有flag，找到所有与搜索词匹配的flag，并将其地址插入到all_matches中
+// 遍历所有flag，找到所有与搜索词匹配的flag并分类，每类最多保留max_kept_per_category个
 // 并且将这些flag的名字的最长公共前缀存储在longest_common_prefix中
-static void FindMatchingFlags(
+static void FindAndCategorizeMatchingFlags(
     const vector<CommandLineFlagInfo> &all_flags,
     const CompletionOptions &options,
     const string &match_token,
-    set<const CommandLineFlagInfo *> *all_matches,
+    const string &module,
+    const string &package_dir,
+    size_t max_kept_per_category,
+    CategorizedMatches *matches,
     string *longest_common_prefix) {
-  all_matches->clear();
   bool first_match = true;
   for (vector<CommandLineFlagInfo>::const_iterator it = all_flags.begin();
       it != all_flags.end();
       ++it) {
-    if (DoesSingleFlagMatch(*it, options, match_token)) {
-      // 将匹配的flag的地址插入到all_matches中
-      all_matches->insert(&*it);
-      if (first_match) {
-        first_match = false;
-        // 将第一个匹配的flag的名字存储在longest_common_prefix中（初始化）
-        *longest_common_prefix = it->name;
-      } else {
-        if (longest_common_prefix->empty() || it->name.empty()) {
-          longest_common_prefix->clear();
-          continue;
-        }
-        string::size_type pos = 0;
-        // 寻找最长的公共前缀
-        while (pos < longest_common_prefix->size() &&
-            pos < it->name.size() &&
-            (*longest_common_prefix)[pos] == it->name[pos])
-          ++pos;
-        // erase将删除pos位置之后的所有字符
-        longest_common_prefix->erase(pos);
+    if (!DoesSingleFlagMatch(*it, options, match_token))
+      continue;
+    CategorizedMatches::Category &category =
+        matches->categories[CategorizeFlag(*it, match_token,
+                                           module, package_dir)];
+    ++matches->count;
+    ++category.count;
+    if (category.kept.size() < max_kept_per_category)
+      category.kept.push_back(&*it);
+    if (first_match) {
+      first_match = false;
+      // 将第一个匹配的flag的名字存储在longest_common_prefix中（初始化）
+      *longest_common_prefix = it->name;
+    } else {
+      if (longest_common_prefix->empty() || it->name.empty()) {
+        longest_common_prefix->clear();
+        continue;
       }
+      string::size_type pos = 0;
+      // 寻找最长的公共前缀
+      while (pos < longest_common_prefix->size() &&
+          pos < it->name.size() &&
+          (*longest_common_prefix)[pos] == it->name[pos])
+        ++pos;
+      // erase将删除pos位置之后的所有字符
+      longest_common_prefix->erase(pos);
     }
   }
 }
@@ -442,62 +454,47 @@ static bool DoesSingleFlagMatch(
 
 // 3) Categorize matches (and helper method)
 
-// Given a set of matching flags, categorize them by
-// likely relevance to this specific binary
-// 将匹配的flag分为完全匹配、模块匹配、包匹配、常用匹配和子包匹配
-static void CategorizeAllMatchingFlags(
-    const set<const CommandLineFlagInfo *> &all_matches,
+// Given a matching flag, categorize it by likely relevance to this
+// specific binary
+// 将匹配的flag归为完全匹配、模块匹配、包匹配或子包匹配
+static FlagCategory CategorizeFlag(
+    const CommandLineFlagInfo &flag,
     const string &search_token,
     const string &module,  // empty if we couldn't find any
-    const string &package_dir,  // empty if we couldn't find any
-    NotableFlags *notable_flags) {
-  notable_flags->perfect_match_flag.clear();
-  notable_flags->module_flags.clear();
-  notable_flags->package_flags.clear();
-  notable_flags->most_common_flags.clear();
-  notable_flags->subpackage_flags.clear();
-
-  for (set<const CommandLineFlagInfo *>::const_iterator it =
-        all_matches.begin();
-      it != all_matches.end();
-      ++it) {
-    DVLOG(2) << "Examining match '" << (*it)->name << "'";
-    DVLOG(7) << "  filename: '" << (*it)->filename << "'";
-    string::size_type pos = string::npos;
-    if (!package_dir.empty())
-      pos = (*it)->filename.find(package_dir);
-    string::size_type slash = string::npos;
-    if (pos != string::npos)  // candidate for package or subpackage match
-      slash = (*it)->filename.find(
-          PATH_SEPARATOR,
-          pos + package_dir.size() + 1);
-
-    // flag的名字与搜索词完全匹配
-    if ((*it)->name == search_token) {
-      // Exact match on some flag's name
-      notable_flags->perfect_match_flag.insert(*it);
-      DVLOG(3) << "Result: perfect match";
-    // flag所在文件的文件名与模块文件名完全匹配
-    } else if (!module.empty() && (*it)->filename == module) {
-      // Exact match on module filename
-      notable_flags->module_flags.insert(*it);
-      DVLOG(3) << "Result: module match";
-    // 标志所在的文件名包含给定的包目录，并且该文件名在包目录之后没有进一步的子目录（即没有更深层次的路径分隔符）
-    } else if (!package_dir.empty() &&
-        pos != string::npos && slash == string::npos) {
+    const string &package_dir) {  // empty if we couldn't find any
+  DVLOG(2) << "Examining match '" << flag.name << "'";
+  DVLOG(7) << "  filename: '" << flag.filename << "'";
+  // flag的名字与搜索词完全匹配
+  if (flag.name == search_token) {
+    // Exact match on some flag's name
+    DVLOG(3) << "Result: perfect match";
+    return PERFECT_MATCH_FLAG;
+  }
+  // flag所在文件的文件名与模块文件名完全匹配
+  if (!module.empty() && flag.filename == module) {
+    // Exact match on module filename
+    DVLOG(3) << "Result: module match";
+    return MODULE_FLAG;
+  }
+  string::size_type pos = string::npos;
+  if (!package_dir.empty())
+    pos = flag.filename.find(package_dir);
+  if (pos != string::npos) {  // candidate for package or subpackage match
+    const string::size_type slash = flag.filename.find(
+        PATH_SEPARATOR,
+        pos + package_dir.size() + 1);
+    // 标志所在的文件名包含给定的包目录，并且该文件名在包目录之后没有进一步的子目录
+    if (slash == string::npos) {
       // In the package, since there was no slash after the package portion
-      notable_flags->package_flags.insert(*it);
       DVLOG(3) << "Result: package match";
-    // 标志所在的文件名包含给定的包目录，并且该文件名在包目录之后有进一步的子目录（即有更深层次的路径分隔符）
-    } else if (!package_dir.empty() &&
-        pos != string::npos && slash != string::npos) {
-      // In a subdirectory of the package
-      notable_flags->subpackage_flags.insert(*it);
-      DVLOG(3) << "Result: subpackage match";
+      return PACKAGE_FLAG;
     }
-
-    DVLOG(3) << "Result: not special match";
+    // In a subdirectory of the package
+    DVLOG(3) << "Result: subpackage match";
+    return SUBPACKAGE_FLAG;
   }
+  DVLOG(3) << "Result: not special match";
+  return OTHER_FLAG;
 }
 
 static void PushNameWithSuffix(vector<string>* suffixes, const char* suffix) {
@@ -545,30 +542,31 @@ static void TryFindModuleAndPackageDir(
   }
 }
 
-// Can't specialize template type on a locally defined type.  Silly C++...
-struct DisplayInfoGroup {
+// Unless otherwise required, only 99 lines should be output to prevent
+// bash from harassing the user.
+static int MaxDesiredLines(const CompletionOptions &options) {
+  // "999999 flags should be enough for anyone.  -dave"
+  return (options.return_all_matching_flags ? 999999 : 98);
+}
+
+// The header and footer output around the flags of each FlagCategory.
+static const struct {
   const char* header;
   const char* footer;
-  set<const CommandLineFlagInfo *> *group;
-
-  int SizeInLines() const {
-    int size_in_lines = static_cast<int>(group->size()) + 1;
-    if (strlen(header) > 0) {
-      size_in_lines++;
-    }
-    if (strlen(footer) > 0) {
-      size_in_lines++;
-    }
-    return size_in_lines;
-  }
+} kCategoryDisplay[NUM_FLAG_CATEGORIES] = {
+  { "",                                 "==========" },
+  { "-* Matching module flags *-",      "===========================" },
+  { "-* Matching package flags *-",     "============================" },
+  { "-* Commonly used flags *-",        "=========================" },
+  { "-* Matching sub-package flags *-", "================================" },
+  { "-* Other flags *-",                "" },
 };
 
 // 4) Finalize and trim output flag set
 // 将所有flag的信息输出到completions中，限制输出的行数不超过99行
 static void FinalizeCompletionOutput(
-    const set<const CommandLineFlagInfo *> &matching_flags,
+    const CategorizedMatches &matches,
     CompletionOptions *options,
-    NotableFlags *notable_flags,
     vector<string> *completions) {
 
   // We want to output lines in groups.  Each group needs to be indented
@@ -580,85 +578,37 @@ static void FinalizeCompletionOutput(
   // nonempty group, there will be ~3 lines of header & footer, plus all
   // output lines themselves.
   // 确保输出的行数不超过99行
-  int max_desired_lines =  // "999999 flags should be enough for anyone.  -dave"
-    (options->return_all_matching_flags ? 999999 : 98);
+  const int max_desired_lines = MaxDesiredLines(*options);
   int lines_so_far = 0;
 
-  vector<DisplayInfoGroup> output_groups;
-  bool perfect_match_found = false;
-  if (!notable_flags->perfect_match_flag.empty()) {
-    perfect_match_found = true;
-    DisplayInfoGroup group =
-        { "",
-          "==========",
-          &notable_flags->perfect_match_flag };
-    lines_so_far += group.SizeInLines();
-    output_groups.push_back(group);
-  }
-  if (lines_so_far < max_desired_lines &&
-      !notable_flags->module_flags.empty()) {
-    DisplayInfoGroup group = {
-        "-* Matching module flags *-",
-        "===========================",
-        &notable_flags->module_flags };
-    lines_so_far += group.SizeInLines();
-    output_groups.push_back(group);
-  }
-  if (lines_so_far < max_desired_lines &&
-      !notable_flags->package_flags.empty()) {
-    DisplayInfoGroup group = {
-        "-* Matching package flags *-",
-        "============================",
-        &notable_flags->package_flags };
-    lines_so_far += group.SizeInLines();
-    output_groups.push_back(group);
-  }
-  if (lines_so_far < max_desired_lines &&
-      !notable_flags->most_common_flags.empty()) {
-    DisplayInfoGroup group = {
-        "-* Commonly used flags *-",
-        "=========================",
-        &notable_flags->most_common_flags };
-    lines_so_far += group.SizeInLines();
-    output_groups.push_back(group);
-  }
-  if (lines_so_far < max_desired_lines &&
-      !notable_flags->subpackage_flags.empty()) {
-    DisplayInfoGroup group = {
-        "-* Matching sub-package flags *-",
-        "================================",
-        &notable_flags->subpackage_flags };
-    lines_so_far += group.SizeInLines();
-    output_groups.push_back(group);
-  }
-
-  set<const CommandLineFlagInfo *> obscure_flags;  // flags not notable
-  if (lines_so_far < max_desired_lines) {
-    RetrieveUnusedFlags(matching_flags, *notable_flags, &obscure_flags);
-    if (!obscure_flags.empty()) {
-      DisplayInfoGroup group = {
-          "-* Other flags *-",
-          "",
-          &obscure_flags };
-      lines_so_far += group.SizeInLines();
-      output_groups.push_back(group);
-    }
+  vector<int> output_groups;
+  for (int i = 0; i < NUM_FLAG_CATEGORIES; ++i) {
+    const CategorizedMatches::Category &category = matches.categories[i];
+    if (category.count == 0)
+      continue;
+    if (lines_so_far >= max_desired_lines)
+      break;
+    lines_so_far += static_cast<int>(category.count) + 1 +
+                    (kCategoryDisplay[i].header[0] != '\0') +
+                    (kCategoryDisplay[i].footer[0] != '\0');
+    output_groups.push_back(i);
   }
 
   // Second, go through each of the chosen output groups and output
   // as many of those flags as we can, while remaining below our limit
   int remaining_lines = max_desired_lines;
   size_t completions_output = 0;
+  bool perfect_match_found =
+      (matches.categories[PERFECT_MATCH_FLAG].count > 0);
   int indent = static_cast<int>(output_groups.size()) - 1;
-  for (vector<DisplayInfoGroup>::const_iterator it =
-        output_groups.begin();
+  for (vector<int>::const_iterator it = output_groups.begin();
       it != output_groups.end();
       ++it, --indent) {
     OutputSingleGroupWithLimit(
-        *it->group,  // group
+        matches.categories[*it].kept,  // group
         string(indent, ' '),  // line indentation
-        string(it->header),  // header
-        string(it->footer),  // footer
+        string(kCategoryDisplay[*it].header),  // header
+        string(kCategoryDisplay[*it].footer),  // footer
         perfect_match_found,  // long format
         &remaining_lines,  // line limit - reduces this by number printed
         &completions_output,  // completions (not lines) added
@@ -666,7 +616,7 @@ static void FinalizeCompletionOutput(
     perfect_match_found = false;
   }
 
-  if (completions_output != matching_flags.size()) {
+  if (completions_output != matches.count) {
     options->force_no_update = false;
     completions->push_back("~ (Remaining flags hidden) ~");
   } else {
@@ -674,32 +624,11 @@ static void FinalizeCompletionOutput(
   }
 }
 
-// 将未使用的flag（即不属于任何特殊类别的flag）插入到unused_flags中
-static void RetrieveUnusedFlags(
-    const set<const CommandLineFlagInfo *> &matching_flags,
-    const NotableFlags &notable_flags,
-    set<const CommandLineFlagInfo *> *unused_flags) {
-  // Remove from 'matching_flags' set all members of the sets of
-  // flags we've already printed (specifically, those in notable_flags)
-  for (set<const CommandLineFlagInfo *>::const_iterator it =
-        matching_flags.begin();
-      it != matching_flags.end();
-      ++it) {
-    if (notable_flags.perfect_match_flag.count(*it) ||
-        notable_flags.module_flags.count(*it) ||
-        notable_flags.package_flags.count(*it) ||
-        notable_flags.most_common_flags.count(*it) ||
-        notable_flags.subpackage_flags.count(*it))
-      continue;
-    unused_flags->insert(*it);
-  }
-}
-
 // 5) Output matches (and helper methods)
 
 // 在completion中输出一个flag组，包括header、footer和group中的所有flag，限制行数不超过remaining_line_limit
 static void OutputSingleGroupWithLimit(
-    const set<const CommandLineFlagInfo *> &group,
+    const vector<const CommandLineFlagInfo *> &group,
     const string &line_indentation,
     const string &header,
     const string &footer,
@@ -714,7 +643,7 @@ static void OutputSingleGroupWithLimit(
     completions->push_back(line_indentation + header);
     completions->push_back(line_indentation + string(header.size(), '-'));
   }
-  for (set<const CommandLineFlagInfo *>::const_iterator it = group.begin();
+  for (vector<const CommandLineFlagInfo *>::const_iterator it = group.begin();
       it != group.end() && *remaining_line_limit > 0;
       ++it) {
     --*remaining_line_limit;
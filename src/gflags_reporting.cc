@@ -70,6 +70,7 @@ DEFINE_string(helpmatch,   "",    "show help on modules whose name contains the
 DEFINE_bool  (helppackage, false, "show help on all modules in the main package");
 DEFINE_bool  (helpxml,     false, "produce an xml version of help");
 DEFINE_bool  (version,     false, "show version and build info and exit");
+DEFINE_string(validate_flagfiles, "", "check these comma-separated flagfiles, or the files in these directories, print a report and exit");
 
 
 namespace GFLAGS_NAMESPACE {
@@ -89,64 +90,65 @@ using std::vector;
 
 static const int kLineLength = 80;
 
-// 将字符串s添加到final_string中，如果final_string的长度加上s的长度大于等于kLineLength，则在final_string后添加换行符
-static void AddString(const string& s,
-                      string* final_string, int* chars_in_line) {
-  const int slen = static_cast<int>(s.length());
+// Appends " label: value" to *out, on a new line if it would reach
+// kLineLength.  Values of string flags are quoted.
+static void AddField(const char* label, const string& value, bool quoted,
+                     string* out, int* chars_in_line) {
+  const int label_len = static_cast<int>(strlen(label));
+  const int slen = label_len + 2 + static_cast<int>(value.length()) +
+      (quoted ? 2 : 0);
   if (*chars_in_line + 1 + slen >= kLineLength) {  // < 80 chars/line
-    *final_string += "\n      ";
+    out->append("\n      ", 7);
     *chars_in_line = 6;
   } else {
-    *final_string += " ";
+    *out += ' ';
     *chars_in_line += 1;
   }
-  *final_string += s;
+  out->append(label, label_len);
+  out->append(": ", 2);
+  if (quoted) *out += '"';
+  *out += value;
+  if (quoted) *out += '"';
   *chars_in_line += slen;
 }
 
-// 打印字符串标志，如果是字符串类型，则在字符串两侧添加引号
-static string PrintStringFlagsWithQuotes(const CommandLineFlagInfo& flag,
-                                         const string& text, bool current) {
-  const char* c_string = (current ? flag.current_value.c_str() :
-                          flag.default_value.c_str());
-  if (strcmp(flag.type.c_str(), "string") == 0) {  // add quotes for strings
-    return StringPrintf("%s: \"%s\"", text.c_str(), c_string);
-  } else {
-    return StringPrintf("%s: %s", text.c_str(), c_string);
-  }
-}
-
-// Create a descriptive string for a flag.
-// Goes to some trouble to make pretty line breaks.
+// Appends the description of flag to *out, as DescribeOneFlag()
+// returns it, going to some trouble to make pretty line breaks.
+// *scratch is working space; passing the same buffers for many flags
+// saves allocations.
 // 将一个flag的信息（包括flag的名字、描述、类型、默认值、当前值）格式化为一个字符串
 // 例如：-flag_name (flag description) type: int default: 0 currently: 1
 // 在字符串长度超过80时，会在适当的位置添加换行符
-string DescribeOneFlag(const CommandLineFlagInfo& flag) {
-  string main_part;
-  SStringPrintf(&main_part, "    -%s (%s)",
-                flag.name.c_str(),
-                flag.description.c_str());
+static void AppendFlagDescription(const CommandLineFlagInfo& flag,
+                                  string* scratch, string* out) {
+  string& main_part = *scratch;
+  main_part.assign("    -", 5);
+  main_part += flag.name;
+  main_part.append(" (", 2);
+  main_part += flag.description;
+  main_part += ')';
   const char* c_string = main_part.c_str();
   // 代表每一行还剩下多少个字符可以添加
   int chars_left = static_cast<int>(main_part.length());
-  string final_string;
   // 代表当前行已经有多少个字符
   int chars_in_line = 0;  // how many chars in current line so far?
   while (1) {
-    assert(static_cast<size_t>(chars_left)
-            == strlen(c_string));  // Unless there's a \0 in there?
-    const char* newline = strchr(c_string, '\n');
+    // Only a newline within what is left of this line matters; if the
+    // rest fits, that covers all of it.
+    const int window = kLineLength - chars_in_line;
+    const char* newline = static_cast<const char*>(
+        memchr(c_string, '\n', chars_left < window ? chars_left : window));
     // c_string中无换行符且当前行的字符数加上当前可用字符数小于80时，将剩余字符全部添加到当前行
     if (newline == NULL && chars_in_line+chars_left < kLineLength) {
       // The whole remainder of the string fits on this line
-      final_string += c_string;
+      out->append(c_string, chars_left);
       chars_in_line += chars_left;
       break;
     }
     // c_string中含有换行符，将换行符前的字符添加到当前行
-    if (newline != NULL && newline - c_string < kLineLength - chars_in_line) {
+    if (newline != NULL) {
       int n = static_cast<int>(newline - c_string);
-      final_string.append(c_string, n);
+      out->append(c_string, n);
       chars_left -= n + 1;
       c_string += n + 1;
     // 此时的else代表当前行到换行符处的字符数大于当前行可用的字符数，需要在适当的位置换行，即在最后一个空格处换行
@@ -160,11 +162,11 @@ string DescribeOneFlag(const CommandLineFlagInfo& flag) {
       if (whitespace <= 0) {
         // Couldn't find any whitespace to make a line break.  Just dump the
         // rest out!
-        final_string += c_string;
+        out->append(c_string, chars_left);
         chars_in_line = kLineLength;  // next part gets its own line for sure!
         break;
       }
-      final_string += string(c_string, whitespace);
+      out->append(c_string, whitespace);
       chars_in_line += whitespace;
       while (isspace(c_string[whitespace]))  ++whitespace;
       c_string += whitespace;
@@ -172,55 +174,83 @@ string DescribeOneFlag(const CommandLineFlagInfo& flag) {
     }
     if (*c_string == '\0')
       break;
-    StringAppendF(&final_string, "\n      ");
+    out->append("\n      ", 7);
     chars_in_line = 6;
   }
 
+  const bool quoted = flag.type == "string";   // add quotes for strings
   // Append data type
-  AddString(string("type: ") + flag.type, &final_string, &chars_in_line);
+  AddField("type", flag.type, false, out, &chars_in_line);
+  // A derived flag has no default of its own, only the current value.
+  if (!flag.derived_from.empty()) {
+    AddField("derived from", flag.derived_from, false, out, &chars_in_line);
+    AddField("currently", flag.current_value, quoted, out, &chars_in_line);
+    *out += '\n';
+    return;
+  }
   // The listed default value will be the actual default from the flag
   // definition in the originating source file, unless the value has
   // subsequently been modified using SetCommandLineOptionWithMode() with mode
   // SET_FLAGS_DEFAULT, or by setting FLAGS_foo = bar before ParseCommandLineFlags().
-  AddString(PrintStringFlagsWithQuotes(flag, "default", false), &final_string,
-            &chars_in_line);
+  AddField("default", flag.default_value, quoted, out, &chars_in_line);
   if (!flag.is_default) {
-    AddString(PrintStringFlagsWithQuotes(flag, "currently", true),
-              &final_string, &chars_in_line);
+    AddField("currently", flag.current_value, quoted, out, &chars_in_line);
   }
 
-  StringAppendF(&final_string, "\n");
-  return final_string;
+  *out += '\n';
+}
+
+// Create a descriptive string for a flag.
+// Goes to some trouble to make pretty line breaks.
+string DescribeOneFlag(const CommandLineFlagInfo& flag) {
+  string scratch, description;
+  AppendFlagDescription(flag, &scratch, &description);
+  return description;
 }
 
-// Simple routine to xml-escape a string: escape & and < only.
-static string XMLText(const string& txt) {
-  string ans = txt;
-  for (string::size_type pos = 0; (pos = ans.find("&", pos)) != string::npos; )
-    ans.replace(pos++, 1, "&amp;");
-  for (string::size_type pos = 0; (pos = ans.find("<", pos)) != string::npos; )
-    ans.replace(pos++, 1, "&lt;");
-  return ans;
+// Simple routine to xml-escape a string: escape & and < only.  Appends
+// to *r in one pass, copying the runs between escapes as a whole.
+static void AppendXMLText(const char* txt, string* r) {
+  const char* run = txt;
+  for (const char* c = txt; *c != '\0'; ++c) {
+    const char* escape;
+    switch (*c) {
+      case '&': escape = "&amp;"; break;
+      case '<': escape = "&lt;"; break;
+      default: continue;
+    }
+    r->append(run, c - run);
+    r->append(escape);
+    run = c + 1;
+  }
+  r->append(run);
 }
 
 static void AddXMLTag(string* r, const char* tag, const string& txt) {
-  StringAppendF(r, "<%s>%s</%s>", tag, XMLText(txt).c_str(), tag);
+  *r += '<';
+  *r += tag;
+  *r += '>';
+  AppendXMLText(txt.c_str(), r);
+  *r += "</";
+  *r += tag;
+  *r += '>';
 }
 
 
-static string DescribeOneFlagInXML(const CommandLineFlagInfo& flag) {
+static void AppendOneFlagInXML(const CommandLineFlagInfo& flag, string* r) {
   // The file and flagname could have been attributes, but default
   // and meaning need to avoid attribute normalization.  This way it
   // can be parsed by simple programs, in addition to xml parsers.
-  string r("<flag>");
-  AddXMLTag(&r, "file", flag.filename);
-  AddXMLTag(&r, "name", flag.name);
-  AddXMLTag(&r, "meaning", flag.description);
-  AddXMLTag(&r, "default", flag.default_value);
-  AddXMLTag(&r, "current", flag.current_value);
-  AddXMLTag(&r, "type", flag.type);
-  r += "</flag>";
-  return r;
+  *r += "<flag>";
+  AddXMLTag(r, "file", flag.filename);
+  AddXMLTag(r, "name", flag.name);
+  AddXMLTag(r, "meaning", flag.description);
+  AddXMLTag(r, "default", flag.default_value);
+  AddXMLTag(r, "current", flag.current_value);
+  AddXMLTag(r, "type", flag.type);
+  if (!flag.derived_from.empty())
+    AddXMLTag(r, "derived_from", flag.derived_from);
+  *r += "</flag>";
 }
 
 // --------------------------------------------------------------------
@@ -247,6 +277,16 @@ static string Dirname(const string& filename) {
   return filename.substr(0, (sep == string::npos) ? 0 : sep);
 }
 
+// Whether the two files are in the same directory, without copying
+// their directory names.
+static bool SameDirname(const string& a, const string& b) {
+  string::size_type a_sep = a.rfind(PATH_SEPARATOR);
+  string::size_type b_sep = b.rfind(PATH_SEPARATOR);
+  if (a_sep == string::npos) a_sep = 0;
+  if (b_sep == string::npos) b_sep = 0;
+  return a_sep == b_sep && a.compare(0, a_sep, b, 0, b_sep) == 0;
+}
+
 // Test whether a filename contains at least one of the substrings.
 // 查找当前flag是否定义在要执行的文件中
 static bool FileMatchesSubstring(const string& filename,
@@ -284,6 +324,7 @@ static void ShowUsageWithFlagsMatching(const char *argv0,
   GetAllFlags(&flags);           // flags are sorted by filename, then flagname
 
   string last_filename;          // so we know when we're at a new file
+  string scratch, description;   // reused for all flags
   bool first_directory = true;   // controls blank lines between dirs
   bool found_match = false;      // stays false iff no dir matches restrict
   for (vector<CommandLineFlagInfo>::const_iterator flag = flags.begin();
@@ -295,7 +336,7 @@ static void ShowUsageWithFlagsMatching(const char *argv0,
       // If the flag has been stripped, pretend that it doesn't exist.
       if (flag->description == kStrippedFlagHelp) continue;
       if (flag->filename != last_filename) {                      // new file
-        if (Dirname(flag->filename) != Dirname(last_filename)) {  // new dir!
+        if (!SameDirname(flag->filename, last_filename)) {        // new dir!
           if (!first_directory)
             fprintf(stdout, "\n\n");   // put blank lines between directories
           first_directory = false;
@@ -304,7 +345,9 @@ static void ShowUsageWithFlagsMatching(const char *argv0,
         last_filename = flag->filename;
       }
       // Now print this flag
-      fprintf(stdout, "%s", DescribeOneFlag(*flag).c_str());
+      description.clear();
+      AppendFlagDescription(*flag, &scratch, &description);
+      fwrite(description.data(), 1, description.size(), stdout);
     }
   }
   if (!found_match && !substrings.empty()) {
@@ -331,24 +374,40 @@ static void ShowXMLOfFlags(const char *prog_name) {
   vector<CommandLineFlagInfo> flags;
   GetAllFlags(&flags);   // flags are sorted: by filename, then flagname
 
+  // Build the whole document in one buffer, sized for the common case
+  // of little escaping, and write it out at once.
+  size_t size = 256 + strlen(ProgramUsage());
+  for (vector<CommandLineFlagInfo>::const_iterator flag = flags.begin();
+       flag != flags.end();
+       ++flag) {
+    size += 128 + flag->filename.size() + flag->name.size() +
+        flag->description.size() + flag->default_value.size() +
+        flag->current_value.size() + flag->derived_from.size();
+  }
+  string r;
+  r.reserve(size);
+
   // XML.  There is no corresponding schema yet
-  fprintf(stdout, "<?xml version=\"1.0\"?>\n");
+  r += "<?xml version=\"1.0\"?>\n";
   // The document
-  fprintf(stdout, "<AllFlags>\n");
+  r += "<AllFlags>\n";
   // the program name and usage
-  fprintf(stdout, "<program>%s</program>\n",
-          XMLText(Basename(prog_name)).c_str());
-  fprintf(stdout, "<usage>%s</usage>\n",
-          XMLText(ProgramUsage()).c_str());
+  AddXMLTag(&r, "program", Basename(prog_name));
+  r += '\n';
+  AddXMLTag(&r, "usage", ProgramUsage());
+  r += '\n';
   // All the flags
   for (vector<CommandLineFlagInfo>::const_iterator flag = flags.begin();
        flag != flags.end();
        ++flag) {
-    if (flag->description != kStrippedFlagHelp)
-      fprintf(stdout, "%s\n", DescribeOneFlagInXML(*flag).c_str());
+    if (flag->description != kStrippedFlagHelp) {
+      AppendOneFlagInXML(*flag, &r);
+      r += '\n';
+    }
   }
   // The end of the document
-  fprintf(stdout, "</AllFlags>\n");
+  r += "</AllFlags>\n";
+  fwrite(r.data(), 1, r.size(), stdout);
 }
 
 // --------------------------------------------------------------------
@@ -461,6 +520,22 @@ void HandleCommandLineHelpFlags() {
     // Unlike help, we may be asking for version in a script, so return 0
     gflags_exitfunc(0);
 
+  } else if (!FLAGS_validate_flagfiles.empty()) {
+    vector<string> paths;
+    for (size_t pos = 0; pos <= FLAGS_validate_flagfiles.size(); ) {
+      size_t comma = FLAGS_validate_flagfiles.find(',', pos);
+      if (comma == string::npos)
+        comma = FLAGS_validate_flagfiles.size();
+      if (comma > pos)
+        paths.push_back(FLAGS_validate_flagfiles.substr(pos, comma - pos));
+      pos = comma + 1;
+    }
+    string report;
+    const bool valid = ValidateFlagfiles(paths, &report);
+    fputs(report.c_str(), stdout);
+    // Meant for scripts as well, so only invalid flagfiles fail.
+    gflags_exitfunc(valid ? 0 : 1);
+
   }
 }
 
@@ -57,6 +57,10 @@ namespace GFLAGS_NAMESPACE {
 // This is used for unittests for death-testing.  It is defined in gflags.cc.
 extern GFLAGS_DLL_DECL void (*gflags_exitfunc)(int);
 
+// This is used by the unittest to see how flags were added.  It is
+// defined in gflags.cc.
+extern GFLAGS_DLL_DECL int gflags_merged_flag_batches;
+
 // Work properly if either strtoll or strtoq is on this system.
 #if defined(strtoll) || defined(HAVE_STRTOLL)
 #  define strto64  strtoll
@@ -0,0 +1,89 @@
+// Copyright (c) 2024, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ---
+// Loads the plugin named by argv[1], which defines --plugin_flag, its
+// alias --plugin_old_flag and --plugin_lazy_flag, and checks that
+// UnregisterFlagsFromModule() removes them before the plugin is
+// unloaded, leaving their values alone.
+
+#include <gflags/gflags.h>
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+DEFINE_int32(host_flag, 2, "A flag of the program");
+
+static int Fail(const char* what) {
+  fprintf(stderr, "FAIL: %s\n", what);
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  using GFLAGS_NAMESPACE::GetCommandLineOption;
+  using GFLAGS_NAMESPACE::SetCommandLineOption;
+  if (argc != 2)
+    return Fail("usage: gflags_plugin_test <plugin>");
+  void* const plugin = dlopen(argv[1], RTLD_NOW);
+  if (plugin == NULL)
+    return Fail(dlerror());
+  void* const function = dlsym(plugin, "gflags_plugin_function");
+  if (function == NULL)
+    return Fail(dlerror());
+  typedef const char* (*LazyFlagFunction)();
+  LazyFlagFunction const lazy_flag = reinterpret_cast<LazyFlagFunction>(
+      dlsym(plugin, "gflags_plugin_lazy_flag"));
+  if (lazy_flag == NULL)
+    return Fail(dlerror());
+
+  std::string value;
+  if (!GetCommandLineOption("plugin_old_flag", &value) || value != "1")
+    return Fail("the flags of the plugin are not registered");
+  {
+    GFLAGS_NAMESPACE::FlagSaver saver;
+    SetCommandLineOption("plugin_flag", "3");
+    SetCommandLineOption("plugin_lazy_flag", "busy");
+    SetCommandLineOption("host_flag", "4");
+    if (GFLAGS_NAMESPACE::UnregisterFlagsFromModule(function) != 2)
+      return Fail("the flags of the plugin were not unregistered");
+    if (strcmp(lazy_flag(), "busy") != 0)
+      return Fail("the lazy flag lost its value");
+    dlclose(plugin);
+    if (GetCommandLineOption("plugin_flag", &value) ||
+        GetCommandLineOption("plugin_old_flag", &value) ||
+        GetCommandLineOption("plugin_lazy_flag", &value))
+      return Fail("the flags of the plugin are still registered");
+  }   // must not touch the unloaded plugin
+  if (FLAGS_host_flag != 2)
+    return Fail("the flags of the program were not restored");
+  printf("PASS\n");
+  return 0;
+}
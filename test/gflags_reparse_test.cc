@@ -0,0 +1,51 @@
+// Copyright (c) 2024, Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+//     * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above
+// copyright notice, this list of conditions and the following disclaimer
+// in the documentation and/or other materials provided with the
+// distribution.
+//     * Neither the name of Google Inc. nor the names of its
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ---
+// A program that reparses a command line holding an @file argument.
+// Reparsing expands the response file again, reusing its words, so
+// this checks that it releases only the arguments it copied, and that
+// the words are released once at shutdown.
+
+#include <gflags/gflags.h>
+
+#include <stdio.h>
+
+DEFINE_string(message, "", "The message to print");
+
+int main(int argc, char** argv) {
+  GFLAGS_NAMESPACE::AllowCommandLineResponseFiles();
+  GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  FLAGS_message = "";
+  GFLAGS_NAMESPACE::ReparseCommandLineNonHelpFlags();
+  GFLAGS_NAMESPACE::ReparseCommandLineNonHelpFlags();
+  printf("%s\n", FLAGS_message.c_str());
+  GFLAGS_NAMESPACE::ShutDownCommandLineFlags();   // releases the file
+  return 0;
+}
@@ -44,6 +44,9 @@
 #ifdef HAVE_UNISTD_H
 #  include <unistd.h>   // for unlink()
 #endif
+#ifdef HAVE_PTHREAD
+#  include <pthread.h>
+#endif
 #include <vector>
 #include <string>
 TEST_INIT
@@ -95,6 +98,43 @@ DEFINE_string(test_str3, "initial", "");
 // This is used to test setting tryfromenv manually
 DEFINE_string(test_tryfromenv, "initial", "");
 
+// Statically initialized, so it can be read before main().
+DEFINE_lazy_string(test_lazy_string, "lazy", "");
+static const string lazy_string_at_startup = FLAGS_test_lazy_string.str();
+
+// Other names for flags; the second is registered before its flag.
+DEFINE_alias(test_old_int32, test_int32);
+DEFINE_deprecated_alias(test_older_string, test_late_string);
+DEFINE_string(test_late_string, "late", "");
+
+// A small hierarchy of flags, for the prefix queries.
+DEFINE_int32(test_tree_cache_size, 10, "");
+DEFINE_int32(test_tree_cache_ttl, 60, "");
+DEFINE_string(test_tree_cache_name, "c", "");
+DEFINE_int32(test_tree_caches, 1, "");
+DEFINE_bool(test_tree_log, false, "");
+
+// A derived flag, counting how often it is computed.
+DEFINE_int32(test_total_budget, 100, "");
+DEFINE_int32(test_worker_threads, 4, "");
+static int per_worker_budget_computations = 0;
+static int32 PerWorkerBudget() {
+  ++per_worker_budget_computations;
+  return FLAGS_test_total_budget / FLAGS_test_worker_threads;
+}
+DEFINE_derived(test_per_worker_budget, int32,
+               (test_total_budget, test_worker_threads), PerWorkerBudget,
+               "the budget of each worker");
+// One derived from it.
+static int half_budget_computations = 0;
+static int32 HalfBudget() {
+  ++half_budget_computations;
+  return FLAGS_test_per_worker_budget.value_ / 2;
+}
+DEFINE_derived(test_half_worker_budget, int32,
+               (test_per_worker_budget), HalfBudget,
+               "half the budget of each worker");
+
 // Don't try this at home!
 static int changeable_var = 12;
 DEFINE_int32(changeable_var, ++changeable_var, "");
@@ -157,6 +197,10 @@ DEFINE_bool(deadlock_if_cant_lock,
             "if locking of registry in validators fails.");
 DEFINE_validator(deadlock_if_cant_lock, DeadlockIfCantLockInValidators);
 
+// Flags of a pretend "ingest" subcommand
+DEFINE_int32(test_ingest_batch, 10, "only known to the ingest subcommand");
+DEFINE_flag_group(test_ingest_batch, ingest);
+
 #define MAKEFLAG(x) DEFINE_int32(test_flag_num##x, x, "Test flag")
 
 // Define 10 flags
@@ -479,6 +523,57 @@ TEST(FlagFileTest, FilenamesOurfileInBigList) {
 }
 #endif  // defined(HAVE_FNMATCH_H) || defined(HAVE_SHLWAPI_H)
 
+// Tests [prefix] sections, and how they mix with filename sections
+TEST(FlagFileTest, PrefixSections) {
+  FLAGS_test_string = "initial";
+  FLAGS_test_bool = false;
+  FLAGS_test_int32 = -1;
+  FLAGS_test_double = -1.0;
+  TestFlagString(
+      // Flag string
+      "[test]\n"
+      "  string=scoped\n"
+      "  -test_int32=1\n"
+      "[]\n"
+      "not_our_filename\n"
+      "[test]\n"
+      "double=1000.0\n"
+      "gflags_unittest\n"
+      "bool=true\n"                   // a filename: the section ended
+      "-test_bool=true\n"
+      "[test]\n"
+      "# comments work in sections too\n"
+      "bool=false\n",
+      // Expected values
+      "scoped",
+      false,
+      1,
+      -1.0);
+}
+
+// Tests names that aren't flags of a section, but name one with it
+TEST(FlagFileTest, PrefixSectionsWithAliasesAndOddHeaders) {
+  FLAGS_test_string = "initial";
+  FLAGS_test_bool = false;
+  FLAGS_test_int32 = -1;
+  FLAGS_test_double = -1.0;
+  TestFlagString(
+      // Flag string
+      "[test]\n"
+      "old_int32=7\n"                 // the alias test_old_int32
+      "no_such_flag=1\n"
+      "[t\xe9st]\n"                   // a filename, not a header
+      "string=not_scoped\n"
+      "gflags_unittest\n"
+      "[test]\n"
+      "bool=true\n",
+      // Expected values
+      "initial",
+      true,
+      7,
+      -1.0);
+}
+
 // Tests that a failed flag-from-string read keeps flags at default values
 TEST(FlagFileTest, FailReadFlagsFromString) {
   FLAGS_test_int32 = 119;
@@ -497,6 +592,63 @@ TEST(FlagFileTest, FailReadFlagsFromString) {
   EXPECT_EQ("initial", FLAGS_test_string);
 }
 
+TEST(FlagFileTest, ReadFlagsFromStringRestricted) {
+  FlagUpdateLimits limits;
+  limits.max_flags = 2;
+  limits.max_value_length = 8;
+  FLAGS_test_int32 = 119;
+  EXPECT_TRUE(ReadFlagsFromStringRestricted("-test_int32=120\n"
+                                            "[test]\n"
+                                            "string=update\n", limits));
+  EXPECT_EQ(120, FLAGS_test_int32);
+  EXPECT_EQ("update", FLAGS_test_string);
+
+  // Each of these fails, and takes back the change to test_int32.
+  const char* const bad_updates[] = {
+    "-test_int32=121\n-test_string=much_too_long\n",
+    "-test_int32=121\n-test_bool=true\n-test_double=1.0\n",
+    "-test_int32=121\n-flagfile=/etc/passwd\n",
+    "-test_int32=121\n-test_double=illegal\n",
+  };
+  for (size_t i = 0; i < arraysize(bad_updates); ++i) {
+    EXPECT_FALSE(ReadFlagsFromStringRestricted(bad_updates[i], limits));
+    EXPECT_EQ(120, FLAGS_test_int32);
+    EXPECT_EQ("update", FLAGS_test_string);
+  }
+
+  limits.max_input_bytes = 8;
+  EXPECT_FALSE(ReadFlagsFromStringRestricted("-test_int32=121\n", limits));
+  EXPECT_EQ(120, FLAGS_test_int32);
+}
+
+#if !defined(_WIN32)
+// Waits up to five seconds for *flag to become value.
+static bool WaitForFlagValue(const int32* flag, int32 value) {
+  for (int i = 0; i < 500 && *flag != value; ++i)
+    usleep(10000);
+  return *flag == value;
+}
+
+TEST(ScheduleFlagChangeTest, AppliedLater) {
+  EXPECT_FALSE(ScheduleFlagChangeAfter("no_such_flag", "1", 0));
+  EXPECT_FALSE(ScheduleFlagChangeAfter("test_int32", "not_a_number", 0));
+
+  FLAGS_test_int32 = 1;
+  if (!ScheduleFlagChangeAfter("test_int32", "2", 0.01))
+    return;   // built without threads
+  EXPECT_TRUE(WaitForFlagValue(&FLAGS_test_int32, 2));
+
+  EXPECT_TRUE(ScheduleFlagChange("test_int32", "3", 0));  // already due
+  EXPECT_TRUE(WaitForFlagValue(&FLAGS_test_int32, 3));
+
+  EXPECT_TRUE(ReadFlagsFromString("@+0.2 --test_int32=4\n"
+                                  "@ --test_int32=5\n",        // ignored
+                                  GetArgv0(), false));
+  EXPECT_EQ(3, FLAGS_test_int32);
+  EXPECT_TRUE(WaitForFlagValue(&FLAGS_test_int32, 4));
+}
+#endif
+
 // Tests that flags can be set to ordinary values.
 TEST(SetFlagValueTest, OrdinaryValues) {
   EXPECT_EQ("initial", FLAGS_test_str1);
@@ -603,6 +755,428 @@ TEST(SetFlagValueTest, DifferentRadices) {
 }
 
 // Tests what happens when you try to set a flag to an illegal value
+static bool ValidateNotBad(const char*, const string& value) {
+  return value != "bad";
+}
+
+TEST(SetFlagValueTest, LazyString) {
+  EXPECT_EQ("lazy", lazy_string_at_startup);
+  EXPECT_STREQ("lazy", FLAGS_test_lazy_string.c_str());
+
+  string value;
+  EXPECT_TRUE(GetCommandLineOption("test_lazy_string", &value));
+  EXPECT_EQ("lazy", value);
+
+  {
+    FlagSaver fs;
+    EXPECT_EQ("test_lazy_string set to busy\n",
+              SetCommandLineOption("test_lazy_string", "busy"));
+    EXPECT_STREQ("busy", FLAGS_test_lazy_string.c_str());
+    CommandLineFlagInfo info;
+    EXPECT_TRUE(GetCommandLineFlagInfo("test_lazy_string", &info));
+    EXPECT_EQ("string", info.type);
+    EXPECT_EQ("lazy", info.default_value);
+    EXPECT_FALSE(info.is_default);
+
+    EXPECT_TRUE(RegisterFlagValidator(&FLAGS_test_lazy_string,
+                                      &ValidateNotBad));
+    EXPECT_EQ("", SetCommandLineOption("test_lazy_string", "bad"));
+    EXPECT_EQ("busy", FLAGS_test_lazy_string.str());
+    EXPECT_TRUE(RegisterFlagValidator(&FLAGS_test_lazy_string, NULL));
+
+    SetCommandLineOptionWithMode("test_lazy_string", "lax",
+                                 SET_FLAGS_DEFAULT);
+    EXPECT_TRUE(GetCommandLineFlagInfo("test_lazy_string", &info));
+    EXPECT_EQ("lax", info.default_value);
+  }
+  // The FlagSaver restored both the value and the default.
+  EXPECT_STREQ("lazy", FLAGS_test_lazy_string.c_str());
+  EXPECT_EQ("lazy", GetCommandLineFlagInfoOrDie("test_lazy_string")
+                        .default_value);
+}
+
+TEST(FlagAliasTest, SetsTheFlagItStandsFor) {
+  EXPECT_EQ("test_int32 set to 5\n",
+            SetCommandLineOption("test_old_int32", "5"));
+  EXPECT_EQ(5, FLAGS_test_int32);
+  EXPECT_EQ("test_late_string set to new\n",
+            SetCommandLineOption("test_older_string", "new"));
+  EXPECT_EQ("new", FLAGS_test_late_string);
+
+  const char* argv[] = { "program", "--test-old-int32=7",
+                         "--test_older_string", "newer" };
+  int argc = arraysize(argv);
+  char** argv_ptr = const_cast<char**>(argv);
+  ParseCommandLineNonHelpFlags(&argc, &argv_ptr, true);
+  EXPECT_EQ(7, FLAGS_test_int32);
+  EXPECT_EQ("newer", FLAGS_test_late_string);
+
+  CommandLineFlagInfo info;
+  EXPECT_TRUE(GetCommandLineFlagInfo("test_old_int32", &info));
+  EXPECT_EQ("test_int32", info.name);
+
+  {
+    FlagSaver fs;
+    SetCommandLineOption("test_old_int32", "11");
+    EXPECT_EQ(11, FLAGS_test_int32);
+  }
+  EXPECT_EQ(7, FLAGS_test_int32);
+
+  // GetAllFlags() lists every flag once, under its own name.
+  vector<CommandLineFlagInfo> flags;
+  GetAllFlags(&flags);
+  int int32_entries = 0;
+  for (size_t i = 0; i < flags.size(); ++i) {
+    EXPECT_NE("test_old_int32", flags[i].name);
+    EXPECT_NE("test_older_string", flags[i].name);
+    if (flags[i].name == "test_int32")
+      ++int32_entries;
+  }
+  EXPECT_EQ(1, int32_entries);
+}
+
+static void AppendFlagName(const CommandLineFlagInfo& flag, void* names) {
+  static_cast<vector<string>*>(names)->push_back(flag.name);
+}
+
+TEST(FlagPrefixTest, ForEachFlagWithPrefix) {
+  vector<string> names;
+  EXPECT_EQ(3, ForEachFlagWithPrefix("test_tree.cache", &AppendFlagName,
+                                     &names));
+  EXPECT_EQ(3, static_cast<int>(names.size()));
+  EXPECT_EQ("test_tree_cache_name", names[0]);
+  EXPECT_EQ("test_tree_cache_size", names[1]);
+  EXPECT_EQ("test_tree_cache_ttl", names[2]);
+
+  names.clear();
+  EXPECT_EQ(1, ForEachFlagWithPrefix("test_tree_cache_ttl", &AppendFlagName,
+                                     &names));
+  EXPECT_EQ(5, ForEachFlagWithPrefix("test_tree_", &AppendFlagName, &names));
+  EXPECT_EQ(5, ForEachFlagWithPrefix("test_tree", &AppendFlagName, &names));
+  EXPECT_EQ(0, ForEachFlagWithPrefix("test_tre", &AppendFlagName, &names));
+}
+
+TEST(FlagPrefixTest, SetFlagsWithPrefix) {
+  EXPECT_EQ("test_tree_cache_name set to 7\n"
+            "test_tree_cache_size set to 7\n"
+            "test_tree_cache_ttl set to 7\n",
+            SetFlagsWithPrefix("test_tree.cache", "7"));
+  EXPECT_EQ(7, FLAGS_test_tree_cache_size);
+  EXPECT_EQ(7, FLAGS_test_tree_cache_ttl);
+  EXPECT_EQ("7", FLAGS_test_tree_cache_name);
+  EXPECT_EQ(1, FLAGS_test_tree_caches);
+
+  // Only the string flag takes a word; the others report it.
+  EXPECT_EQ("test_tree_cache_name set to big\n"
+            "ERROR: illegal value 'big' specified for int32 flag"
+            " 'test_tree_cache_size'\n"
+            "ERROR: illegal value 'big' specified for int32 flag"
+            " 'test_tree_cache_ttl'\n",
+            SetFlagsWithPrefix("test_tree.cache", "big"));
+  EXPECT_EQ(7, FLAGS_test_tree_cache_size);
+  EXPECT_EQ("big", FLAGS_test_tree_cache_name);
+  EXPECT_EQ("", SetFlagsWithPrefix("test_tree.no_such_subtree", "1"));
+}
+
+TEST(FlagPrefixTest, FlagSaverWithPrefix) {
+  {
+    FlagSaver fs("test_tree.cache");
+    FLAGS_test_tree_cache_size = 20;
+    FLAGS_test_tree_cache_name = "d";
+    FLAGS_test_tree_caches = 2;
+  }
+  EXPECT_EQ(10, FLAGS_test_tree_cache_size);
+  EXPECT_EQ("c", FLAGS_test_tree_cache_name);
+  EXPECT_EQ(2, FLAGS_test_tree_caches);   // not in the subtree
+}
+
+TEST(DerivedFlagTest, ComputedOnceAfterEachChange) {
+  EXPECT_EQ(25, FLAGS_test_per_worker_budget.Get());
+  const int computations = per_worker_budget_computations;
+  EXPECT_EQ(25, FLAGS_test_per_worker_budget.Get());
+  EXPECT_EQ(computations, per_worker_budget_computations);
+
+  SetCommandLineOption("test_worker_threads", "5");
+  const int32 budget = FLAGS_test_per_worker_budget;
+  EXPECT_EQ(20, budget);
+  EXPECT_EQ(20, FLAGS_test_per_worker_budget.Get());
+  EXPECT_EQ(computations + 1, per_worker_budget_computations);
+
+  // Changes of unrelated flags don't cause a computation.
+  SetCommandLineOption("test_int32", "3");
+  EXPECT_EQ(20, FLAGS_test_per_worker_budget.Get());
+  EXPECT_EQ(computations + 1, per_worker_budget_computations);
+
+  {
+    FlagSaver fs;
+    SetCommandLineOption("test_total_budget", "200");
+    EXPECT_EQ(40, FLAGS_test_per_worker_budget.Get());
+  }
+  EXPECT_EQ(20, FLAGS_test_per_worker_budget.Get());
+}
+
+TEST(DerivedFlagTest, DerivedFromDerivedFlag) {
+  FlagSaver fs;
+  SetCommandLineOption("test_total_budget", "100");
+  SetCommandLineOption("test_worker_threads", "5");
+  // Not reading test_per_worker_budget in between.
+  EXPECT_EQ(10, FLAGS_test_half_worker_budget.Get());
+  SetCommandLineOption("test_total_budget", "60");
+  EXPECT_EQ(6, FLAGS_test_half_worker_budget.Get());
+  const int computations = half_budget_computations;
+  EXPECT_EQ(6, FLAGS_test_half_worker_budget.Get());
+  EXPECT_EQ(12, FLAGS_test_per_worker_budget.Get());
+  EXPECT_EQ(computations, half_budget_computations);
+
+  // Two changes, one computation.
+  SetCommandLineOption("test_total_budget", "40");
+  EXPECT_EQ(8, FLAGS_test_per_worker_budget.Get());
+  SetCommandLineOption("test_worker_threads", "4");
+  EXPECT_EQ(5, FLAGS_test_half_worker_budget.Get());
+  EXPECT_EQ(computations + 1, half_budget_computations);
+}
+
+TEST(DerivedFlagTest, ReadOnlyAndShownAsDerived) {
+  EXPECT_EQ("", SetCommandLineOption("test_per_worker_budget", "3"));
+  EXPECT_EQ(25, FLAGS_test_per_worker_budget.Get());
+
+  SetCommandLineOption("test_total_budget", "40");
+  CommandLineFlagInfo info;
+  EXPECT_TRUE(GetCommandLineFlagInfo("test_per_worker_budget", &info));
+  EXPECT_EQ("int32", info.type);
+  EXPECT_EQ("10", info.current_value);
+  EXPECT_EQ("test_total_budget, test_worker_threads", info.derived_from);
+  EXPECT_TRUE(info.is_default);
+  const string description = DescribeOneFlag(info);
+  EXPECT_NE(string::npos, description.find(
+      "derived from: test_total_budget, test_worker_threads"));
+  EXPECT_NE(string::npos, description.find("currently: 10"));
+
+  // It is left out when flags are written out to be read back.
+  EXPECT_EQ(string::npos,
+            CommandlineFlagsIntoString().find("test_per_worker_budget"));
+}
+
+TEST(CachedStringFlagTest, RefreshedAfterChanges) {
+  CachedStringFlag reader(&FLAGS_test_str1);
+  EXPECT_EQ("initial", reader.Get());
+  EXPECT_EQ(&reader.Get(), &reader.Get());   // the same copy
+
+  SetCommandLineOption("test_str1", "changed");
+  EXPECT_EQ("changed", reader.Get());
+  {
+    FlagSaver fs;
+    SetCommandLineOption("test_str1", "saved");
+    EXPECT_EQ("saved", reader.Get());
+  }
+  EXPECT_EQ("changed", reader.Get());
+
+  // Setting other string flags leaves its copy alone, as an assignment
+  // behind gflags' back shows.
+  FLAGS_test_str1 = "unseen";
+  SetCommandLineOption("test_str2", "other");
+  EXPECT_EQ("changed", reader.Get());
+  FLAGS_test_str1 = "changed";
+}
+
+TEST(CachedStringFlagTest, NotRefreshedBySavingFlags) {
+  CachedStringFlag reader(&FLAGS_test_str1);
+  EXPECT_EQ("initial", reader.Get());
+  // Assigned behind gflags' back, so only a string flag change made
+  // through gflags would make the reader copy it.
+  FLAGS_test_str1 = "unseen";
+  {
+    FlagSaver fs;
+  }
+  EXPECT_EQ("initial", reader.Get());
+}
+
+TEST(CachedStringFlagTest, ManyReaders) {
+  vector<CachedStringFlag*> readers;
+  for (int i = 0; i < 2000; ++i)   // more than there are pthread keys
+    readers.push_back(new CachedStringFlag(&FLAGS_test_str1));
+  SetCommandLineOption("test_str1", "many");
+  for (size_t i = 0; i < readers.size(); ++i) {
+    EXPECT_EQ("many", readers[i]->Get());
+    delete readers[i];
+  }
+  CachedStringFlag reader(&FLAGS_test_str1);   // reuses a slot
+  EXPECT_EQ("many", reader.Get());
+}
+
+TEST(FlagSandboxTest, ParsesIntoTheSandboxOnly) {
+  FLAGS_test_int32 = 3;
+  FLAGS_test_bool = true;
+  FLAGS_test_string = "global";
+  const char* argv[] = { "program", "--test_int32=7", "--notest_bool",
+                         "--test_string", "sandboxed", "--undefok=nosuch",
+                         "--nosuch", "rest" };
+  int argc = sizeof(argv) / sizeof(*argv);
+  char** args = const_cast<char**>(argv);
+  FlagSandbox sandbox;
+  string errors = "not cleared";
+  EXPECT_EQ(1, static_cast<int>(
+      sandbox.ParseCommandLineFlags(&argc, &args, true, &errors)));
+  EXPECT_EQ("", errors);
+  EXPECT_EQ(2, argc);
+  EXPECT_STREQ("rest", args[1]);
+
+  EXPECT_EQ(3, FLAGS_test_int32);
+  EXPECT_TRUE(FLAGS_test_bool);
+  EXPECT_EQ("global", FLAGS_test_string);
+  EXPECT_EQ(3, GetFlag(FLAGS_test_int32));   // no sandbox in use
+  {
+    FlagSandbox::Scope scope(sandbox);
+    EXPECT_EQ(7, GetFlag(FLAGS_test_int32));
+    EXPECT_FALSE(GetFlag(FLAGS_test_bool));
+    EXPECT_EQ("sandboxed", GetFlag(FLAGS_test_string));
+    EXPECT_EQ(-1.0, GetFlag(FLAGS_test_double));   // not set in the sandbox
+    FlagSandbox inner;
+    {
+      FlagSandbox::Scope inner_scope(inner);
+      EXPECT_EQ(3, GetFlag(FLAGS_test_int32));
+    }
+    EXPECT_EQ(7, GetFlag(FLAGS_test_int32));
+  }
+  EXPECT_EQ(3, GetFlag(FLAGS_test_int32));
+
+  string value;
+  EXPECT_TRUE(sandbox.GetCommandLineOption("test_int32", &value));
+  EXPECT_EQ("7", value);
+  EXPECT_TRUE(sandbox.GetCommandLineOption("test_double", &value));
+  EXPECT_EQ("-1", value);
+  EXPECT_EQ("test_int32 set to 8\n",
+            sandbox.SetCommandLineOption("test_old_int32", "8"));
+  EXPECT_EQ("", sandbox.SetCommandLineOption("test_int32", "eight"));
+  EXPECT_EQ(3, FLAGS_test_int32);
+  EXPECT_TRUE(sandbox.GetCommandLineOption("test_int32", &value));
+  EXPECT_EQ("8", value);
+}
+
+TEST(FlagSandboxTest, ValuesOutliveLaterChanges) {
+  FlagSandbox sandbox;
+  sandbox.SetCommandLineOption("test_string", "first");
+  FlagSandbox::Scope scope(sandbox);
+  const string& first = GetFlag(FLAGS_test_string);
+  sandbox.SetCommandLineOption("test_string", "second");
+  EXPECT_EQ("first", first);
+  EXPECT_EQ("second", GetFlag(FLAGS_test_string));
+}
+
+TEST(FlagSandboxTest, ErrorsAreNotFatal) {
+  const char* argv[] = { "program", "--test_int32=seven", "--nosuch" };
+  int argc = sizeof(argv) / sizeof(*argv);
+  char** args = const_cast<char**>(argv);
+  FlagSandbox sandbox;
+  string errors;
+  sandbox.ParseCommandLineFlags(&argc, &args, false, &errors);
+  EXPECT_NE(string::npos, errors.find("illegal value 'seven'"));
+  EXPECT_NE(string::npos, errors.find("unknown command line flag 'nosuch'"));
+  EXPECT_EQ(-1, FLAGS_test_int32);
+}
+
+TEST(FlagSuggestionTest, SuggestsTheClosestFlags) {
+  const char* argv[] = { "program", "--tset_int32=1", "--test_int",
+                         "--qwertyuiop" };
+  int argc = sizeof(argv) / sizeof(*argv);
+  char** args = const_cast<char**>(argv);
+  FlagSandbox sandbox;
+  string errors;
+  sandbox.ParseCommandLineFlags(&argc, &args, false, &errors);
+  EXPECT_NE(string::npos, errors.find(
+      "unknown command line flag 'tset_int32' (did you mean 'test_int32'?)\n"));
+  EXPECT_NE(string::npos, errors.find(
+      "unknown command line flag 'test_int' "
+      "(did you mean 'test_int32' or 'test_int64'?)\n"));
+  EXPECT_NE(string::npos, errors.find(
+      "unknown command line flag 'qwertyuiop'\n"));
+}
+
+TEST(FlagLookupTest, FindsEveryFlagByName) {
+  vector<CommandLineFlagInfo> flags;
+  GetAllFlags(&flags);
+  for (size_t i = 0; i < flags.size(); ++i) {
+    CommandLineFlagInfo info;
+    EXPECT_TRUE(GetCommandLineFlagInfo(flags[i].name.c_str(), &info));
+    EXPECT_EQ(flags[i].name, info.name);
+    EXPECT_FALSE(GetCommandLineFlagInfo((flags[i].name + "_").c_str(),
+                                        &info));
+  }
+  CommandLineFlagInfo info;
+  EXPECT_TRUE(GetCommandLineFlagInfo("test_old_int32", &info));
+  EXPECT_EQ("test_int32", info.name);
+  EXPECT_TRUE(GetCommandLineFlagInfo("test-int32", &info));
+  EXPECT_EQ("test_int32", info.name);
+  EXPECT_FALSE(GetCommandLineFlagInfo("", &info));
+}
+
+TEST(CompareAndSetTest, ComparesValues) {
+  SetCommandLineOption("test_int32", "10");
+  EXPECT_FALSE(CompareAndSetCommandLineOption("test_int32", "11", "20"));
+  EXPECT_EQ(10, FLAGS_test_int32);
+  EXPECT_TRUE(CompareAndSetCommandLineOption("test_int32", "0xa", "20"));
+  EXPECT_EQ(20, FLAGS_test_int32);
+  EXPECT_FALSE(CompareAndSetCommandLineOption("test_int32", "20", "x"));
+  EXPECT_FALSE(CompareAndSetCommandLineOption("test_int32", "x", "30"));
+  EXPECT_FALSE(CompareAndSetCommandLineOption("no_such_flag", "", ""));
+  EXPECT_EQ(20, FLAGS_test_int32);
+
+  FLAGS_test_bool = true;   // plain assignments are compared too
+  EXPECT_TRUE(CompareAndSetCommandLineOption("test_bool", "1", "false"));
+  EXPECT_FALSE(FLAGS_test_bool);
+  EXPECT_TRUE(CompareAndSetCommandLineOption("test_string", "initial", "x"));
+  EXPECT_EQ("x", FLAGS_test_string);
+}
+
+TEST(CompareAndSetTest, ComparesGenerations) {
+  string value;
+  uint64 generation;
+  EXPECT_TRUE(GetCommandLineOptionGeneration("test_int32", &value,
+                                             &generation));
+  EXPECT_EQ("-1", value);
+  SetCommandLineOption("test_int32", "0");
+  SetCommandLineOption("test_int32", "-1");   // back to the same value
+  EXPECT_FALSE(CompareAndSetCommandLineOptionGeneration("test_int32",
+                                                        generation, "5"));
+  EXPECT_EQ(-1, FLAGS_test_int32);
+
+  // Settings that leave the value alone are no changes.
+  EXPECT_TRUE(GetCommandLineOptionGeneration("test_int32", &value,
+                                             &generation));
+  SetCommandLineOption("test_int32", "-1");
+  SetCommandLineOptionWithMode("test_int32", "7", SET_FLAG_IF_DEFAULT);
+  EXPECT_EQ(-1, FLAGS_test_int32);
+  EXPECT_TRUE(CompareAndSetCommandLineOptionGeneration("test_int32",
+                                                       generation, "5"));
+  EXPECT_EQ(5, FLAGS_test_int32);
+  EXPECT_FALSE(CompareAndSetCommandLineOptionGeneration("test_int32",
+                                                        generation, "6"));
+  EXPECT_FALSE(GetCommandLineOptionGeneration("no_such_flag", &value,
+                                              &generation));
+}
+
+TEST(DescribeOneFlagTest, WrapsAndQuotes) {
+  CommandLineFlagInfo info;
+  info.name = "x";
+  info.type = "string";
+  info.description = "a line\nthen some text";
+  info.default_value = "d";
+  info.current_value = "c";
+  info.is_default = false;
+  EXPECT_EQ("    -x (a line\n"
+            "      then some text) type: string default: \"d\" "
+            "currently: \"c\"\n",
+            DescribeOneFlag(info));
+
+  info.name = "y";
+  info.type = "int32";
+  info.description = "d";
+  info.default_value = string(70, '9');
+  info.is_default = true;
+  EXPECT_EQ("    -y (d) type: int32\n      default: " + string(70, '9') +
+            "\n", DescribeOneFlag(info));
+}
+
 TEST(SetFlagValueTest, IllegalValues) {
   FLAGS_test_bool = true;
   FLAGS_test_int32 = 119;
@@ -879,6 +1453,48 @@ TEST(FlagSaverTest, CanSaveVariousTypedFlagValues) {
   EXPECT_EQ("good", FLAGS_test_string);
 }
 
+// Tests that a flag outlives its FlagRegisterer, since static
+// destructors also run when the program exits.  Unregistering the flags
+// of a plugin is tested by gflags_plugin_test.
+TEST(UnregisterFlagTest, DestroyingRegistererKeepsFlag) {
+  static int32 current = 7;
+  static int32 defvalue = 7;
+  {
+    FlagRegisterer o_test_kept("test_kept", "", __FILE__,
+                               &current, &defvalue);
+  }
+  string value;
+  EXPECT_TRUE(GetCommandLineOption("test_kept", &value));
+  EXPECT_EQ("7", value);
+}
+
+// Tests that flags registered after the registry was first used, here
+// by the validators above, are still added as one batch.
+TEST(RegisterFlagTest, BatchAfterValidator) {
+  static int32 current_a = 1, defvalue_a = 1;
+  static int32 current_b = 2, defvalue_b = 2;
+  const int merged = gflags_merged_flag_batches;
+  FlagRegisterer o_test_batch_b("test_batch_b", "", __FILE__,
+                                &current_b, &defvalue_b);
+  FlagRegisterer o_test_batch_a("test_batch_a", "", __FILE__,
+                                &current_a, &defvalue_a);
+  string value;
+  EXPECT_TRUE(GetCommandLineOption("test_batch_a", &value));
+  EXPECT_EQ("1", value);
+  EXPECT_TRUE(GetCommandLineOption("test_batch_b", &value));
+  EXPECT_EQ("2", value);
+  EXPECT_EQ(merged + 1, gflags_merged_flag_batches);
+  CommandLineFlagInfo info;
+  EXPECT_TRUE(GetCommandLineFlagInfo("test_batch_a", &info));
+  EXPECT_EQ(&current_a, info.flag_ptr);
+}
+
+TEST(UnregisterFlagTest, UnknownModule) {
+  int32* heap_value = new int32(0);
+  EXPECT_EQ(0, UnregisterFlagsFromModule(heap_value));
+  delete heap_value;
+}
+
 TEST(GetAllFlagsTest, BaseTest) {
   vector<CommandLineFlagInfo> flags;
   GetAllFlags(&flags);
@@ -1315,7 +1931,225 @@ TEST(ParseCommandLineFlagsAndDashArgs, OneDashArg) {
   EXPECT_EQ(0, ParseTestFlag(false, arraysize(argv) - 1, argv));
 }
 
+TEST(ParseCommandLineFlagsStreamingFlagfile, LinesSplitAcrossReads) {
+  const string filename(TmpFile("streaming_flagfile"));
+  FILE* fp;
+  EXPECT_EQ(0, SafeFOpen(&fp, filename.c_str(), "w"));
+  // Windows line endings, a line longer than one read, and no newline
+  // after the last line.
+  const string long_value(20000, 'x');
+  fprintf(fp, "# comment\r\n--test_flag=4\r\n--test_string=%s\r\n"
+          "--test_int32=5", long_value.c_str());
+  fclose(fp);
+
+  const string flagfile_arg = "--flagfile=" + filename;
+  const char* const_argv[] = {
+    "my_test",
+    flagfile_arg.c_str(),
+    NULL,
+  };
+  int argc = arraysize(const_argv) - 1;
+  char** argv = const_cast<char**>(const_argv);
+  ParseCommandLineNonHelpFlags(&argc, &argv, true);
+  EXPECT_EQ(4, FLAGS_test_flag);
+  EXPECT_EQ(long_value, FLAGS_test_string);
+  EXPECT_EQ(5, FLAGS_test_int32);
+}
+
+#if defined(HAVE_UNISTD_H) && !defined(_WIN32)
+TEST(ParseCommandLineFlagsStreamingFlagfile, ReadsFromPipe) {
+  int fds[2];
+  EXPECT_EQ(0, pipe(fds));
+  const char contents[] = "--test_flag=6\n";
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(contents) - 1),
+            write(fds[1], contents, sizeof(contents) - 1));
+  close(fds[1]);
+
+  const string flagfile_arg = StringPrintf("--flagfile=/dev/fd/%d", fds[0]);
+  const char* argv[] = {
+    "my_test",
+    flagfile_arg.c_str(),
+    NULL,
+  };
+  EXPECT_EQ(6, ParseTestFlag(false, arraysize(argv) - 1, argv));
+  close(fds[0]);
+}
+
+#if defined(HAVE_PTHREAD)
+static int32 test_flag_parsed_from_pipe = 0;
+static void* ParseFlagfileArg(void* flagfile_arg) {
+  const char* argv[] = {
+    "my_test",
+    static_cast<const char*>(flagfile_arg),
+    NULL,
+  };
+  test_flag_parsed_from_pipe = ParseTestFlag(false, arraysize(argv) - 1, argv);
+  return NULL;
+}
+
+TEST(ParseCommandLineFlagsStreamingFlagfile, UnlockedWhileWaiting) {
+  int fds[2];
+  EXPECT_EQ(0, pipe(fds));
+  string before;
+  EXPECT_TRUE(GetCommandLineOption("test_flag", &before));
+  string flagfile_arg = StringPrintf("--flagfile=/dev/fd/%d", fds[0]);
+  pthread_t parser;
+  EXPECT_EQ(0, pthread_create(&parser, NULL, &ParseFlagfileArg,
+                              &flagfile_arg[0]));
+  const char first[] = "--test_flag=6\n";
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(first) - 1),
+            write(fds[1], first, sizeof(first) - 1));
+  // The parser waits for the rest of the pipe without keeping other
+  // threads from reading flags, and applies it all at once at EOF.
+  usleep(20000);
+  string value;
+  EXPECT_TRUE(GetCommandLineOption("test_flag", &value));
+  EXPECT_EQ(before, value);
+
+  const char second[] = "--test_flag=7\n";
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(second) - 1),
+            write(fds[1], second, sizeof(second) - 1));
+  close(fds[1]);
+  EXPECT_EQ(0, pthread_join(parser, NULL));
+  close(fds[0]);
+  EXPECT_EQ(7, test_flag_parsed_from_pipe);
+}
+#endif
+#endif
+
+#if !defined(_WIN32)
+static void WriteTmpFile(const string& filename, const char* contents) {
+  FILE* fp;
+  EXPECT_EQ(0, SafeFOpen(&fp, filename.c_str(), "w"));
+  fputs(contents, fp);
+  fclose(fp);
+}
+
+TEST(ParseCommandLineFlagsFlagdir, OneFilePerFlag) {
+  const string dir(TmpFile("flagdir"));
+  mkdir(dir.c_str(), 0755);
+  WriteTmpFile(dir + "/test_flag", "8\n");
+  WriteTmpFile(dir + "/test_string", "two words\n");
+  WriteTmpFile(dir + "/.test_int32", "9");     // hidden
+  WriteTmpFile(dir + "/not_a_flag", "10");    // ignored
+  mkdir((dir + "/test_bool").c_str(), 0755);  // not a file
+
+  const string flagdir_arg = "--flagdir=" + dir;
+  const char* const_argv[] = {
+    "my_test",
+    flagdir_arg.c_str(),
+    NULL,
+  };
+  int argc = arraysize(const_argv) - 1;
+  char** argv = const_cast<char**>(const_argv);
+  FLAGS_test_int32 = 1;
+  FLAGS_test_bool = false;
+  ParseCommandLineNonHelpFlags(&argc, &argv, true);
+  EXPECT_EQ(8, FLAGS_test_flag);
+  EXPECT_EQ("two words", FLAGS_test_string);
+  EXPECT_EQ(1, FLAGS_test_int32);
+  EXPECT_FALSE(FLAGS_test_bool);
+}
+
+TEST(ValidateFlagfilesTest, ReportsEachFileAndRestoresFlags) {
+  const string dir(TmpFile("validate_flagfiles"));
+  mkdir(dir.c_str(), 0755);
+  WriteTmpFile(dir + "/a_good", "--test_int32=5\n--test_string=x\n");
+  WriteTmpFile(dir + "/b_bad", "--test_bool\n--test_int32=abc\n");
+  WriteTmpFile(dir + "/c_nested", ("--flagfile=" + dir + "/missing\n").c_str());
+  WriteTmpFile(dir + "/d_directory", ("--flagfile=" + dir + "\n").c_str());
+  WriteTmpFile(dir + "/e_missing_value", "--test_int32\n");
+  WriteTmpFile(dir + "/f_unknown", "--tset_int32=5\n");
+  FLAGS_test_int32 = 1;
+  FLAGS_test_bool = false;
+  FLAGS_test_string = "initial";
+  string flagfile_before, flagfile_after;
+  EXPECT_TRUE(GetCommandLineOption("flagfile", &flagfile_before));
+
+  vector<string> paths;
+  paths.push_back(dir);
+  string report;
+  EXPECT_FALSE(ValidateFlagfiles(paths, &report));
+  EXPECT_EQ(dir + "/a_good\tOK\n" +
+            dir + "/b_bad\tERROR\tillegal value 'abc' specified for int32"
+            " flag 'test_int32'\n" +
+            dir + "/c_nested\tERROR\tcannot read flagfile '" + dir +
+            "/missing': No such file or directory\n" +
+            dir + "/d_directory\tERROR\tcannot read flagfile '" + dir +
+            "': Is a directory\n" +
+            dir + "/e_missing_value\tERROR\tflag 'test_int32' is missing"
+            " its value\n" +
+            dir + "/f_unknown\tERROR\tunknown command line flag"
+            " 'tset_int32' (did you mean 'test_int32'?)\n",
+            report);
+  EXPECT_EQ(1, FLAGS_test_int32);
+  EXPECT_FALSE(FLAGS_test_bool);
+  EXPECT_EQ("initial", FLAGS_test_string);
+  EXPECT_TRUE(GetCommandLineOption("flagfile", &flagfile_after));
+  EXPECT_EQ(flagfile_before, flagfile_after);
+
+  paths[0] = dir + "/a_good";
+  report.clear();
+  EXPECT_TRUE(ValidateFlagfiles(paths, &report));
+  EXPECT_EQ(dir + "/a_good\tOK\n", report);
+  EXPECT_EQ(1, FLAGS_test_int32);
+}
+#endif
+
+TEST(ParseCommandLineFlagsResponseFile, ExpandsWordsOfFile) {
+  const string filename(TmpFile("response_file"));
+  FILE* fp;
+  EXPECT_EQ(0, SafeFOpen(&fp, filename.c_str(), "w"));
+  // The last word ends the file, without a newline after it.
+  fputs("--test_flag=3 'first arg'\n \"second \\\"arg\\\"\"\t--test_string=a\\ b",
+        fp);
+  fclose(fp);
+  AllowCommandLineResponseFiles();
+
+  const string response_arg = "@" + filename;
+  const char* const_argv[] = {
+    "my_test",
+    response_arg.c_str(),
+    "third arg",
+    NULL,
+  };
+  int argc = arraysize(const_argv) - 1;
+  char** argv = const_cast<char**>(const_argv);
+  EXPECT_EQ(1, ParseCommandLineFlags(&argc, &argv, true));
+  EXPECT_EQ(3, FLAGS_test_flag);
+  EXPECT_EQ("a b", FLAGS_test_string);
+  EXPECT_EQ(4, argc);
+  EXPECT_STREQ("first arg", argv[1]);
+  EXPECT_STREQ("second \"arg\"", argv[2]);
+  EXPECT_STREQ("third arg", argv[3]);
+
+  // Nothing after "--" is expanded.
+  const char* const_argv2[] = {
+    "my_test",
+    "--",
+    response_arg.c_str(),
+    NULL,
+  };
+  argc = arraysize(const_argv2) - 1;
+  argv = const_cast<char**>(const_argv2);
+  EXPECT_EQ(1, ParseCommandLineFlags(&argc, &argv, true));
+  EXPECT_EQ(2, argc);
+  EXPECT_STREQ(response_arg.c_str(), argv[1]);
+}
+
 #ifdef GTEST_HAS_DEATH_TEST
+TEST(ParseCommandLineFlagsResponseFileDeathTest, FileIsMissing) {
+  const char* argv[] = {
+    "my_test",
+    "@/this/response/file/does/not/exist",
+    NULL,
+  };
+
+  AllowCommandLineResponseFiles();
+  EXPECT_DEATH(ParseTestFlag(true, arraysize(argv) - 1, argv),
+               "could not read response file");
+}
+
 TEST(ParseCommandLineFlagsUnknownFlagDeathTest,
      FlagIsCompletelyUnknown) {
   const char* argv[] = {
@@ -1359,6 +2193,56 @@ TEST(ParseCommandLineFlagsUnknownFlagDeathTest,
 }
 #endif
 
+TEST(FlagGroupTest, OnlyActiveGroupIsParsed) {
+  FLAGS_test_ingest_batch = 10;
+  EXPECT_FALSE(SetActiveFlagGroup("compact"));
+  EXPECT_TRUE(ReadFlagsFromString("--test_ingest_batch=20\n--test_int32=5",
+                                  GetArgv0(), false));
+  EXPECT_EQ(10, FLAGS_test_ingest_batch);   // inactive, hence unknown
+  EXPECT_EQ(5, FLAGS_test_int32);           // not in any group
+
+  EXPECT_TRUE(SetActiveFlagGroup("ingest"));
+  EXPECT_TRUE(ReadFlagsFromString("--test_ingest_batch=20",
+                                  GetArgv0(), false));
+  EXPECT_EQ(20, FLAGS_test_ingest_batch);
+
+  EXPECT_TRUE(SetActiveFlagGroup(NULL));
+  EXPECT_TRUE(ReadFlagsFromString("--test_ingest_batch=30",
+                                  GetArgv0(), false));
+  EXPECT_EQ(30, FLAGS_test_ingest_batch);
+}
+
+TEST(FlagGroupTest, InactiveGroupIsHidden) {
+  vector<CommandLineFlagInfo> flags;
+  EXPECT_FALSE(SetActiveFlagGroup("compact"));
+  GetAllFlags(&flags);
+  SetActiveFlagGroup(NULL);
+  for (size_t i = 0; i < flags.size(); ++i)
+    EXPECT_NE("test_ingest_batch", flags[i].name);
+
+  // Programmatic access still works.
+  CommandLineFlagInfo info;
+  EXPECT_TRUE(GetCommandLineFlagInfo("test_ingest_batch", &info));
+  // A flag can only be in one group.
+  EXPECT_TRUE(AddFlagToGroup(&FLAGS_test_ingest_batch, "ingest"));
+  EXPECT_FALSE(AddFlagToGroup(&FLAGS_test_ingest_batch, "compact"));
+}
+
+#ifdef GTEST_HAS_DEATH_TEST
+TEST(FlagGroupDeathTest, InactiveGroupFlagIsUnknown) {
+  const char* argv[] = {
+    "my_test",
+    "--test_ingest_batch=20",
+    NULL,
+  };
+
+  SetActiveFlagGroup("compact");
+  EXPECT_DEATH(ParseTestFlag(true, arraysize(argv) - 1, argv),
+               "unknown command line flag.*");
+  SetActiveFlagGroup(NULL);
+}
+#endif
+
 TEST(ParseCommandLineFlagsWrongFields,
      DescriptionIsInvalid) {
   // These must not be automatic variables, since command line flags